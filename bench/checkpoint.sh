@@ -0,0 +1,43 @@
+#!/bin/sh
+# Takes checkpoints of a run with about 32 MB of arrays and stack elements and
+#  reports their size, how long writing one takes, what checkpointing every 500 ms
+#  costs the run, and how long resuming from one takes.
+#
+# usage: bench/checkpoint.sh path/to/ral [program.ral]
+
+RAL=${1:?usage: $0 path/to/ral [program.ral]}
+PROGRAM=${2:-$(dirname "$0")/checkpoint.ral}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+now() { date +%s%N; }
+ms() { echo $(( ($2 - $1) / 1000000 )); }
+
+start=$(now)
+"$RAL" < "$PROGRAM" > /dev/null || exit 1
+plain=$(ms "$start" "$(now)")
+
+start=$(now)
+"$RAL" --checkpoint "$DIR/every" --checkpoint-every 500 < "$PROGRAM" > /dev/null || exit 1
+every=$(ms "$start" "$(now)")
+
+# one checkpoint on request, timed from the signal until the file is in place
+"$RAL" --checkpoint "$DIR/one" < "$PROGRAM" > /dev/null &
+pid=$!
+sleep 1
+start=$(now)
+kill -USR2 "$pid"
+while [ ! -f "$DIR/one" ]; do sleep 0.01; done
+write=$(ms "$start" "$(now)")
+kill "$pid"
+wait "$pid" 2> /dev/null
+
+start=$(now)
+"$RAL" --resume "$DIR/one" < "$PROGRAM" > /dev/null || exit 1
+resume=$(ms "$start" "$(now)")
+
+echo "checkpoint size:            $(wc -c < "$DIR/one") bytes"
+echo "writing a checkpoint:       $write ms"
+echo "run without checkpoints:    $plain ms"
+echo "run with one every 500 ms:  $every ms"
+echo "resumed run after 1 s:      $resume ms"
@@ -0,0 +1,59 @@
+#!/bin/sh
+# Runs a generated module of many functions of which `main` only calls a few, once
+#  with every body parsed up front and once with `--lazy`.
+#
+# usage: bench/lazy.sh path/to/ral [functions]
+
+RAL=${1:?usage: $0 path/to/ral [functions]}
+N=${2:-20000}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+now() { date +%s%N; }
+ms() { echo $(( ($2 - $1) / 1000000 )); }
+
+i=0
+while [ "$i" -lt "$N" ]; do
+  cat <<EOF
+fn f$i(n : int) -> () := {
+  let t := 0;
+  from t = 0 do {
+    if t < 3 {
+      acc += n
+    } else {
+      acc -= n;
+      acc += n
+    };
+    t += 1
+  } until t = 5;
+  unlet t := 5
+}
+EOF
+  i=$((i + 1))
+done > "$DIR/prog.ral"
+cat >> "$DIR/prog.ral" <<EOF
+fn main(x : int) -> () := {
+  let acc := 0;
+  let r := f0(1);
+  unlet r := ();
+  let r := f$((N / 2))(2);
+  unlet r := ();
+  let r := f$((N - 1))(3);
+  unlet r := ();
+  let p := print(acc);
+  unlet p := ();
+  unlet acc := 18
+}
+EOF
+
+start=$(now)
+"$RAL" < "$DIR/prog.ral" > /dev/null || exit 1
+eager=$(ms "$start" "$(now)")
+
+start=$(now)
+"$RAL" --lazy < "$DIR/prog.ral" > /dev/null || exit 1
+lazy=$(ms "$start" "$(now)")
+
+echo "$N functions, 3 called, $(wc -c < "$DIR/prog.ral") bytes"
+echo "all bodies parsed:  $eager ms"
+echo "--lazy:             $lazy ms"
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Calls a loop of arithmetic on many argument tuples with `--each`: in lockstep, one
+#  tuple after the other, and one after the other without compiled closures.
+#
+# usage: bench/lockstep.sh path/to/ral [tuples] [rounds]
+
+RAL=${1:?usage: $0 path/to/ral [tuples] [rounds]}
+N=${2:-20000}
+R=${3:-100}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+now() { date +%s%N; }
+ms() { echo $(( ($2 - $1) / 1000000 )); }
+
+cat > "$DIR/prog.ral" <<EOF
+fn rounds(s : [u64; 4], n : int) -> () := {
+  let i := 0;
+  from i = 0 do {
+    s[0] += s[1];
+    s[3] -= s[0];
+    s[1] *= 3;
+    s[2] += s[3];
+    s[3] *= 5;
+    s[1] -= s[2];
+    s[0] <> s[2];
+    i += 1
+  } until i = n;
+  unlet i := n
+}
+EOF
+
+i=0
+while [ "$i" -lt "$N" ]; do
+  echo "$i $((i * 7)) $((i * 13)) $((i * 31)) $R"
+  i=$((i + 1))
+done > "$DIR/tuples"
+
+run() {
+  start=$(now)
+  "$RAL" --each rounds "$DIR/tuples" "$@" < "$DIR/prog.ral" > "$DIR/out$#" || exit 1
+  ms "$start" "$(now)"
+}
+
+lanes=$(run)
+scalar=$(run --no-lockstep)
+interpreted=$(run --no-lockstep --tier-calls 0 --tier-iterations 0)
+cmp -s "$DIR/out0" "$DIR/out1" || { echo "lockstep and scalar results differ"; exit 1; }
+
+echo "$N tuples, $R rounds of 7 statements each"
+echo "lockstep:           $lanes ms"
+echo "one by one:         $scalar ms"
+echo "one by one, no tier: $interpreted ms"
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Runs a ral program with 1, 2, 4, ... threads up to the number of cores
+#  and reports the wall time and the speedup over a single thread.
+#
+# usage: bench/scaling.sh path/to/ral [program.ral]
+
+RAL=${1:?usage: $0 path/to/ral [program.ral]}
+PROGRAM=${2:-$(dirname "$0")/par_for.ral}
+CORES=$(nproc)
+
+run() {
+  start=$(date +%s%N)
+  "$RAL" --threads "$1" < "$PROGRAM" > /dev/null || exit 1
+  end=$(date +%s%N)
+  echo $(( (end - start) / 1000000 ))
+}
+
+printf "%8s %10s %8s\n" threads "time [ms]" speedup
+report() {
+  ms=$(run "$1")
+  awk -v t="$1" -v ms="$ms" -v base="$base" 'BEGIN { printf "%8d %10d %8.2f\n", t, ms, base / ms }'
+}
+
+base=$(run 1)
+printf "%8d %10d %8.2f\n" 1 "$base" 1
+t=2
+while [ "$t" -lt "$CORES" ]; do
+  report "$t"
+  t=$(( t * 2 ))
+done
+if [ "$CORES" -gt 1 ]; then
+  report "$CORES"
+fi
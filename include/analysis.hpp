@@ -0,0 +1,74 @@
+#pragma once
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+struct Node;
+struct Fn;
+
+// Variables a statement reads and writes. Array elements count as their array.
+struct effects
+{
+  std::set<std::string> reads;
+  std::set<std::string> writes;
+
+  // variables bound by a `let` or a call within the statement
+  std::set<std::string> locals;
+
+  // names of all called and uncalled functions
+  std::set<std::string> callees;
+};
+
+effects effects_of(const Node* n);
+
+// How `do S₁ yield S₂ undo` takes back `S₁`. Running the inverse of `S₁` costs about as
+//  much as `S₁` itself, restoring the values `S₁` overwrote costs as much as copying them.
+// Restoring gives the same result only if `S₂` writes nothing `S₁` touches, and neither
+//  calls functions that could reach the variables of their caller.
+struct undo_plan
+{
+  bool restore { false };
+
+  // variables to save before `S₁` when restoring
+  std::vector<std::string> writes;
+};
+
+undo_plan plan_undo(const Node* n);
+
+// Statements of a block split into stages that run one after the other. A stage is
+//  either a single statement calling impure functions or doing I/O, or groups of
+//  statements where no group writes anything another one reads or writes. The groups
+//  of a stage give the same result in any order, also when run at the same time.
+struct block_plan
+{
+  struct group
+  {
+    std::vector<std::size_t> stmts;
+    std::set<std::string> writes;
+    std::size_t cost { 0 };
+  };
+  using stage = std::vector<group>;
+
+  std::vector<stage> stages;
+
+  // whether some stage has two groups costing at least `min_cost` each
+  bool parallel { false };
+};
+
+block_plan plan_block(const Node* block, const std::set<std::string>& pure,
+                      const std::map<std::string, Fn*>& fns, std::size_t min_cost);
+
+// rough number of steps to run `n`, loops are assumed to iterate a few times
+std::size_t cost_of(const Node* n);
+
+// Functions whose only effect is a function of their arguments: they do no I/O,
+//  don't take arrays, don't touch variables of their caller and only call pure functions.
+std::set<const Fn*> pure_functions(const std::vector<std::unique_ptr<Fn>>& fns);
+
+// Checks the static properties the interpreter relies on, e.g. that the
+//  iterations of a `par` loop are independent. Reports problems to `err`.
+bool verify(const Fn* f, std::ostream& err);
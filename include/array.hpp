@@ -0,0 +1,179 @@
+#pragma once
+
+#include <int_kernels.hpp>
+#include <type.hpp>
+#include <ast.hpp>
+
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <memory>
+
+// Fixed-size array of integers. Elements are stored unboxed and contiguous with
+//  their natural width, so an `[i8; 64]` occupies 64 bytes.
+struct array_value
+{
+  using Ptr = std::shared_ptr<array_value>;
+
+  array_value(TypeKind elem, std::size_t length);
+
+  // Wraps storage owned by someone else, e.g. a caller-provided buffer.
+  array_value(TypeKind elem, std::size_t length, void* borrowed);
+
+  std::size_t load(std::size_t idx) const;
+  void store(std::size_t idx, std::size_t cell);
+
+  // Element-wise updates, `*this ∘= rhs` resp. `*this ∘= scalar`
+  void update(BinOpTypes op, const array_value& rhs);
+  void update(BinOpTypes op, std::size_t scalar);
+  void swap(array_value& rhs);
+
+  void fill(std::size_t cell);
+  bool all_equal(std::size_t cell) const;
+  bool operator==(const array_value& rhs) const;
+
+  std::size_t bytes() const
+  { return length * width; }
+
+  TypeKind elem;
+  std::size_t length;
+  std::size_t width;
+
+  std::unique_ptr<std::byte[]> owned;
+  std::byte* data;
+};
+
+// Bytes of an array of `length` elements, saturating instead of wrapping around.
+std::size_t array_bytes(TypeKind elem, std::size_t length);
+
+// SIMD kernels over contiguous storage. The bulk is processed in vector registers
+//  via the GCC/Clang vector extension, the remainder element by element.
+// Everything is computed on the unsigned type, so overflow wraps like `int_kernel`.
+template<typename T>
+struct array_kernel
+{
+  using U = std::make_unsigned_t<T>;
+
+  static constexpr std::size_t vector_bytes = 16;
+  static constexpr std::size_t lanes = vector_bytes / sizeof(U);
+
+  typedef U vec __attribute__((vector_size(vector_bytes)));
+
+  static vec vload(const U* p)
+  { vec v; std::memcpy(&v, p, sizeof(vec)); return v; }
+
+  static void vstore(U* p, vec v)
+  { std::memcpy(p, &v, sizeof(vec)); }
+
+  // scalar variants compute in 64 bit, small unsigned types would otherwise be promoted to `int`
+  struct add
+  {
+    static vec vector(vec a, vec b) { return a + b; }
+    static U scalar(U a, U b) { return static_cast<U>(std::uint64_t(a) + b); }
+  };
+  struct sub
+  {
+    static vec vector(vec a, vec b) { return a - b; }
+    static U scalar(U a, U b) { return static_cast<U>(std::uint64_t(a) - b); }
+  };
+  struct mul
+  {
+    static vec vector(vec a, vec b) { return a * b; }
+    static U scalar(U a, U b) { return static_cast<U>(std::uint64_t(a) * b); }
+  };
+
+  template<typename Op>
+  static void zip(U* dst, const U* src, std::size_t n)
+  {
+    std::size_t i = 0;
+    for(; i + lanes <= n; i += lanes)
+      vstore(dst + i, Op::vector(vload(dst + i), vload(src + i)));
+    for(; i < n; ++i)
+      dst[i] = Op::scalar(dst[i], src[i]);
+  }
+
+  template<typename Op>
+  static void broadcast(U* dst, U scalar, std::size_t n)
+  {
+    vec s;
+    for(std::size_t l = 0; l < lanes; ++l)
+      s[l] = scalar;
+
+    std::size_t i = 0;
+    for(; i + lanes <= n; i += lanes)
+      vstore(dst + i, Op::vector(vload(dst + i), s));
+    for(; i < n; ++i)
+      dst[i] = Op::scalar(dst[i], scalar);
+  }
+
+  static void update(BinOpTypes op, void* dst, const void* src, std::size_t n)
+  {
+    auto* d = static_cast<U*>(dst);
+    auto* s = static_cast<const U*>(src);
+    switch(op)
+    {
+    case BinOpTypes::Add: zip<add>(d, s, n); return;
+    case BinOpTypes::Sub: zip<sub>(d, s, n); return;
+    case BinOpTypes::Mul: zip<mul>(d, s, n); return;
+    case BinOpTypes::Div:
+      for(std::size_t i = 0; i < n; ++i)
+        d[i] = static_cast<U>(int_kernel<T>::binop(op, int_kernel<T>::pack(T(d[i])), int_kernel<T>::pack(T(s[i]))));
+      return;
+    }
+  }
+
+  static void update(BinOpTypes op, void* dst, std::size_t cell, std::size_t n)
+  {
+    auto* d = static_cast<U*>(dst);
+    const U scalar = static_cast<U>(cell);
+    switch(op)
+    {
+    case BinOpTypes::Add: broadcast<add>(d, scalar, n); return;
+    case BinOpTypes::Sub: broadcast<sub>(d, scalar, n); return;
+    case BinOpTypes::Mul: broadcast<mul>(d, scalar, n); return;
+    case BinOpTypes::Div:
+      for(std::size_t i = 0; i < n; ++i)
+        d[i] = static_cast<U>(int_kernel<T>::binop(op, int_kernel<T>::pack(T(d[i])), cell));
+      return;
+    }
+  }
+
+  static void swap(void* lhs, void* rhs, std::size_t n)
+  {
+    auto* a = static_cast<U*>(lhs);
+    auto* b = static_cast<U*>(rhs);
+
+    std::size_t i = 0;
+    for(; i + lanes <= n; i += lanes)
+    {
+      auto x = vload(a + i);
+      vstore(a + i, vload(b + i));
+      vstore(b + i, x);
+    }
+    for(; i < n; ++i)
+      std::swap(a[i], b[i]);
+  }
+
+  static std::size_t load(const void* data, std::size_t idx)
+  { return int_kernel<T>::pack(T(static_cast<const U*>(data)[idx])); }
+
+  static void store(void* data, std::size_t idx, std::size_t cell)
+  { static_cast<U*>(data)[idx] = static_cast<U>(cell); }
+};
+
+// Applies `F` to a value of the C++ type that backs the integer kind.
+template<typename F>
+decltype(auto) visit_int_kind(TypeKind kind, F&& f)
+{
+  switch(kind)
+  {
+  case TypeKind::I8:  return f(std::int8_t {});
+  case TypeKind::I16: return f(std::int16_t {});
+  case TypeKind::I32: return f(std::int32_t {});
+  case TypeKind::I64: return f(std::int64_t {});
+  default:
+    assert(is_int(kind) && "Expected an integer type.");
+  case TypeKind::U64: return f(std::uint64_t {});
+  }
+}
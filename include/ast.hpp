@@ -1,21 +1,35 @@
 #pragma once
 
+#include <functional>
+#include <cstdint>
+#include <atomic>
+#include <optional>
 #include <variant>
 #include <memory>
 #include <string>
 #include <vector>
+#include <mutex>
 
+struct int_ops;
 struct Type;
 
+// Variables are looked up by name at run time, so a name denotes the same variable in
+//  every function. Each name gets a dense slot the interpreter indexes its variables with.
+std::uint32_t slot_of(const std::string& name);
+std::uint32_t slot_count();
+std::string slot_name(std::uint32_t slot);
+
 struct Object
 {
   Object(const std::string& name, std::shared_ptr<Type> type)
     : name(name)
     , type(type)
+    , slot(slot_of(name))
   {  }
 
   std::string name;
   std::shared_ptr<Type> type;
+  std::uint32_t slot;
 };
 inline bool operator<(const Object& lhs, const Object& rhs)
 { return lhs.name < rhs.name; }
@@ -26,17 +40,31 @@ enum class NodeKind {
   Unit,
   Num,
   Var,
+  Index,
   OpEq,
   Cmp,
+  // a + b, a - b, a * b and a / b, `data` is the operator
+  Arith,
+  // `data` is 1 for the store of an inlined call, which like that of a call binds the
+  //  variable or overwrites it if it is bound already
   Let,
   Unlet,
   If,
   DoYieldUndo,
   Block,
   Loop,
+  ParFor,
   Swap,
   Call,
   Uncall,
+  // push(x, s) moves `x` onto `s` and zeroes it, pop(x, s) is its inverse.
+  // `data` is 1 if they work at the end `pop` takes from: the top of a stack or the
+  //  front of a queue. Pushes start at the back, inverted pops at the front.
+  Push,
+  Pop,
+  // size(s) and top(s), the element `pop` would take
+  Size,
+  Top,
   Stmt,
   Fn,
 };
@@ -59,10 +87,27 @@ struct Fn
   std::vector<Object> params;
   std::unique_ptr<Node> body;
 
+  // what an uncall runs, built once before the program starts
+  std::unique_ptr<Node> inv_body;
+
   std::shared_ptr<Type> typ;
+
+  // whether the function is pure, if already known
+  std::optional<bool> pure;
+
+  // Fills in `body` and `inv_body` of functions that are only materialized on first use,
+  //  e.g. the ones of a compiled module. Safe to call from multiple threads.
+  void load()
+  {
+    if(loader)
+      std::call_once(loaded, loader, *this);
+  }
+
+  std::function<void(Fn&)> loader;
+  std::once_flag loaded;
 };
 
-// +=, -=, *=, /=
+// +=, -=, *=, /= and +, -, *, /
 enum class BinOpTypes
 {
   Add,
@@ -117,6 +162,9 @@ struct Node {
   Data data;
 
   std::shared_ptr<Type> typ;
+
+  // integer handlers of an operation, looked up by the interpreter when it first runs it
+  mutable std::atomic<const int_ops*> ops { nullptr };
 };
 
 
@@ -168,6 +216,20 @@ inline Node::Ptr make_node(NodeKind&& kind, BinOpTypes&& bin, Node::Ptr&& arg0,
   return std::make_unique<Node>(std::move(kind), std::move(bin), std::move(v));
 }
 
+// whether `n` is the `let` storing the result of an inlined call
+inline bool is_store(const Node* n)
+{ return n->kind == NodeKind::Let && std::holds_alternative<std::size_t>(n->data); }
+
+// Deep copy of `n`, including types.
+Node::Ptr clone(const Node* n);
+Fn::Ptr clone(const Fn& f);
+
+// number of nodes of the tree `n`, 0 for none
+std::size_t node_count(const Node* n);
+
+// Builds the statement that undoes `n`.
+Node::Ptr invert(const Node* n);
+
 inline bool is_stmt(NodeKind kind)
 {
   switch(kind)
@@ -181,6 +243,9 @@ inline bool is_stmt(NodeKind kind)
   case NodeKind::Block:
   case NodeKind::Swap:
   case NodeKind::Loop:
+  case NodeKind::ParFor:
+  case NodeKind::Push:
+  case NodeKind::Pop:
   case NodeKind::Stmt:
   case NodeKind::Fn:
     return true;
@@ -199,6 +264,9 @@ inline bool is_expr(NodeKind kind)
   case NodeKind::Block:
   case NodeKind::Swap:
   case NodeKind::Loop:
+  case NodeKind::ParFor:
+  case NodeKind::Push:
+  case NodeKind::Pop:
   case NodeKind::Stmt:
   case NodeKind::Fn:
     return false;
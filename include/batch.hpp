@@ -0,0 +1,16 @@
+#pragma once
+
+#include <ast.hpp>
+#include <interpret.hpp>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Runs the program once per input file, concurrently on the thread pool. `paths` are
+//  files or directories, whose regular files are taken in name order. The output of
+//  running on `x` is written to `x.out`, and `.out` files are never taken as input.
+// All runs share the checked functions, each has its own variables and memo tables.
+// Returns the number of inputs that could not be read or written or hit a limit.
+std::size_t run_batch(const std::vector<std::string>& paths, const std::vector<Fn::Ptr>& fns,
+                      const interpreter_options& opts, std::ostream& err);
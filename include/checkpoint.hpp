@@ -0,0 +1,67 @@
+#pragma once
+
+#include <container.hpp>
+#include <array.hpp>
+#include <ast.hpp>
+
+#include <optional>
+#include <variant>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+// State of a run at a statement boundary, written to a file so that the run can be
+//  resumed later by another process running the same program.
+// Arrays and stacks shared by several variables, e.g. by a parameter and the caller's
+//  argument, are written once and shared again when read back.
+namespace checkpoint
+{
+using value = std::variant<std::monostate, std::size_t, array_value::Ptr, container_value::Ptr>;
+
+// a variable as it was before a `do` block that is undone by putting it back
+struct saved
+{
+  std::string name;
+  std::optional<value> val;
+  std::vector<std::byte> contents;
+};
+
+// A construct the run is inside of, the outermost one first:
+//  Block      `pos` is the statement it is at
+//  Loop       in the body
+//  If         `pos` is the branch taken, 1 or 2
+//  DoYieldUndo  `pos` is the phase, 0 to 2, with the values to put back
+//  Call/Uncall  the body of `fn` with `args`
+// The innermost one is a Block or a Loop, about to run its statement or body.
+struct frame
+{
+  NodeKind kind;
+  std::size_t pos { 0 };
+  std::string fn;
+  std::vector<value> args;
+  std::vector<saved> saved_values;
+};
+
+struct state
+{
+  // `fingerprint` of the program that was running
+  std::uint64_t program { 0 };
+
+  std::vector<std::pair<std::string, value>> vars;
+  std::vector<value> stack;
+  std::vector<frame> frames;
+};
+
+// Hash of the functions as they are about to run, resuming needs the same program.
+std::uint64_t fingerprint(const std::vector<std::unique_ptr<Fn>>& fns);
+
+// Writes to a temporary file renamed to `path` when complete, so that an earlier
+//  checkpoint at `path` survives a crash while writing.
+bool write(const std::string& path, const state& s, std::ostream& err);
+std::optional<state> read(const std::string& path, std::ostream& err);
+
+// After `signal` arrives, the next interpreter to look takes a checkpoint.
+void on_signal(int signal);
+bool requested();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <type.hpp>
+
+#include <cstddef>
+#include <memory>
+
+// Elements of a stack or a queue. They live in one ring buffer of cells that doubles
+//  when full and halves when only a quarter is used, so pushing and popping at either
+//  end take amortized constant time and no element is allocated on its own.
+// Cells are normalized to the element type by the interpreter before they are pushed.
+struct container_value
+{
+  using Ptr = std::shared_ptr<container_value>;
+
+  container_value(TypeKind kind, TypeKind elem);
+
+  void push_back(std::size_t cell);
+  void push_front(std::size_t cell);
+  std::size_t pop_back();
+  std::size_t pop_front();
+
+  std::size_t back() const;
+  std::size_t front() const;
+
+  std::size_t size() const
+  { return count; }
+
+  bool empty() const
+  { return count == 0; }
+
+  // the `i`-th element from the front
+  std::size_t cell(std::size_t i) const
+  { return at(i); }
+
+  void swap(container_value& rhs);
+  bool operator==(const container_value& rhs) const;
+
+  // `TypeKind::Stack` or `TypeKind::Queue`
+  TypeKind kind;
+  TypeKind elem;
+
+private:
+  void reallocate(std::size_t capacity);
+
+  std::size_t& at(std::size_t i) const
+  { return cells[(head + i) & (capacity - 1)]; }
+
+  // `capacity` is 0 or a power of two, the elements are at `head`, `head + 1`, ...
+  std::unique_ptr<std::size_t[]> cells;
+  std::size_t capacity { 0 };
+  std::size_t head { 0 };
+  std::size_t count { 0 };
+};
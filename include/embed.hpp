@@ -0,0 +1,49 @@
+#pragma once
+
+#include <interpret.hpp>
+#include <ast.hpp>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <memory>
+
+// A ral program inside a C++ host. It is loaded and prepared once, then the host calls
+//  and uncalls its functions any number of times on its own integers and buffers.
+// The interpreter, its memo tables and its operand stack are kept from call to call,
+//  so a program must not be called from several threads at once.
+class embedded_program
+{
+public:
+  explicit embedded_program(std::vector<std::string> search_path = {},
+                            const interpreter_options& opts = {});
+  ~embedded_program();
+
+  // Loads the module at `path`, or in `text`, with everything it imports.
+  // Reports problems to `err`, a program is only loaded once.
+  bool load(const std::string& path, std::ostream& err);
+  bool load_text(const std::string& text, std::ostream& err);
+
+  // the function called `name`, or nullptr
+  Fn* find(const std::string& name) const;
+
+  // Run `f` resp. its inverse. Array arguments are used in place, not copied.
+  // Return false if the arguments don't fit, throw `limit_exceeded` or `run_error` like a run.
+  bool call(Fn* f, const host_arg* args, std::size_t n);
+  bool uncall(Fn* f, const host_arg* args, std::size_t n);
+
+  // Run `f` resp. its inverse for each of `count` tuples of `f`'s arguments in `args`,
+  //  several tuples at once where possible, see `session::call_each`.
+  bool call_each(Fn* f, const host_arg* args, std::size_t count);
+  bool uncall_each(Fn* f, const host_arg* args, std::size_t count);
+
+private:
+  bool prepare(bool loaded);
+
+private:
+  std::vector<std::string> search_path;
+  interpreter_options opts;
+
+  std::vector<Fn::Ptr> fns;
+  std::unique_ptr<session> sess;
+};
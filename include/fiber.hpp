@@ -0,0 +1,48 @@
+#pragma once
+
+#include <ucontext.h>
+
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+// Stackful coroutine. `resume` runs the body on the fiber's own stack until the body
+//  calls `suspend` or returns, so everything the body has on its stack survives in
+//  between. A suspended fiber may be resumed by any thread.
+// Destroying a fiber that hasn't finished releases its stack without unwinding it.
+class fiber
+{
+public:
+  using Body = std::function<void(fiber&)>;
+
+  // The stack is reserved up front, but memory is only committed when touched.
+  explicit fiber(Body body, std::size_t stack_bytes = 16 * 1024 * 1024);
+  ~fiber();
+
+  fiber(const fiber&) = delete;
+  fiber& operator=(const fiber&) = delete;
+
+  // Returns whether the body has finished, rethrows what escaped from it.
+  bool resume();
+
+  // Called from within the body, continues after the `resume` that started this slice.
+  void suspend();
+
+  bool done() const
+  { return finished; }
+
+private:
+  static void entry(std::uint32_t hi, std::uint32_t lo);
+
+private:
+  Body body;
+
+  void* stack;
+  std::size_t stack_bytes;
+
+  ucontext_t self;
+  ucontext_t caller;
+
+  bool finished { false };
+  std::exception_ptr failure;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <run_error.hpp>
+#include <type.hpp>
+#include <ast.hpp>
+
+#include <type_traits>
+#include <cstdint>
+#include <ostream>
+
+// Every integer lives in a 64 bit cell. Signed widths are kept sign-extended,
+//  unsigned ones zero-extended, so that cells of the same type compare bitwise.
+// All arithmetic wraps around modulo 2^width, which keeps += and -= mutual inverses.
+template<typename T>
+struct int_kernel
+{
+  static_assert(std::is_integral_v<T>);
+
+  using U = std::make_unsigned_t<T>;
+  using Wide = std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>;
+
+  static T unpack(std::size_t cell)
+  { return static_cast<T>(static_cast<U>(cell)); }
+
+  static std::size_t pack(T v)
+  { return static_cast<std::size_t>(static_cast<Wide>(v)); }
+
+  static std::size_t normalize(std::size_t cell)
+  { return pack(unpack(cell)); }
+
+  static std::size_t binop(BinOpTypes op, std::size_t lhs, std::size_t rhs)
+  {
+    // compute in 64 bit unsigned to avoid the UB of signed overflow and integer promotion
+    const std::uint64_t a = static_cast<U>(lhs);
+    const std::uint64_t b = static_cast<U>(rhs);
+    switch(op)
+    {
+    case BinOpTypes::Add: return pack(static_cast<T>(static_cast<U>(a + b)));
+    case BinOpTypes::Sub: return pack(static_cast<T>(static_cast<U>(a - b)));
+    case BinOpTypes::Mul: return pack(static_cast<T>(static_cast<U>(a * b)));
+    case BinOpTypes::Div:
+    {
+      const T x = unpack(lhs);
+      const T y = unpack(rhs);
+      run_check(y != 0, "Division by zero.");
+
+      // MIN / -1 overflows, wrap it around like the other operators do
+      if constexpr(std::is_signed_v<T>)
+        if(y == T(-1))
+          return pack(static_cast<T>(static_cast<U>(U(0) - static_cast<U>(x))));
+      return pack(static_cast<T>(x / y));
+    }
+    }
+    return lhs;
+  }
+
+  static bool cmp(CmpTypes op, std::size_t lhs, std::size_t rhs)
+  {
+    const T a = unpack(lhs);
+    const T b = unpack(rhs);
+    switch(op)
+    {
+    case CmpTypes::Less:         return a < b;
+    case CmpTypes::LessEqual:    return a <= b;
+    case CmpTypes::Equal:        return a == b;
+    case CmpTypes::InEqual:      return a != b;
+    case CmpTypes::GreaterEqual: return a >= b;
+    case CmpTypes::Greater:      return a > b;
+    }
+    return false;
+  }
+
+  static void print(std::ostream& os, std::size_t cell)
+  { os << static_cast<Wide>(unpack(cell)); }
+};
+
+// Type erased view onto one `int_kernel` instantiation, so the interpreter can
+//  pick the handlers once per node instead of switching on the width per operation.
+struct int_ops
+{
+  std::size_t width;
+
+  std::size_t (*normalize)(std::size_t);
+  std::size_t (*binop)(BinOpTypes, std::size_t, std::size_t);
+  bool (*cmp)(CmpTypes, std::size_t, std::size_t);
+  void (*print)(std::ostream&, std::size_t);
+};
+
+template<typename T>
+constexpr int_ops make_int_ops()
+{
+  return int_ops { sizeof(T),
+                   &int_kernel<T>::normalize,
+                   &int_kernel<T>::binop,
+                   &int_kernel<T>::cmp,
+                   &int_kernel<T>::print };
+}
+
+const int_ops& int_ops_for(TypeKind kind);
+
+inline const int_ops& int_ops_for(const Type::Ptr& typ)
+{ return int_ops_for(typ ? typ->kind : TypeKind::U64); }
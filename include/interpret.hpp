@@ -1,10 +1,119 @@
 #pragma once
 
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
+#include <string>
 #include <vector>
+#include <chrono>
+#include <map>
 
 struct Fn;
+struct Interpreter;
 
-void interpret(std::ostream& os, const std::vector<std::unique_ptr<Fn>>& n);
+struct interpreter_options
+{
+  // bytes all memo tables of pure functions may use together, 0 disables memoization
+  std::size_t memo_limit { 64 * 1024 * 1024 };
+
+  // print hits and misses of the memo tables to `std::cerr` when done
+  bool memo_stats { false };
+
+  // Functions called `tier_calls` times and loops running `tier_iterations` iterations
+  //  at once are compiled to closures, 0 never does. Runs taking checkpoints stay
+  //  interpreted. `tier_stats` reports what was compiled to `std::cerr` when done.
+  std::size_t tier_calls { 16 };
+  std::size_t tier_iterations { 256 };
+  bool tier_stats { false };
+
+  // `call_each` runs tuples in lockstep where it can, see lockstep.hpp
+  bool lockstep { true };
+
+  // Limits of a single run, 0 means unlimited. Steps count evaluated nodes, the
+  //  iterations of a parallel loop each get the limits the loop started with.
+  // Calls recurse on the native stack, the default depth stays well within 8 MB.
+  std::size_t max_stack_bytes { 0 };
+  std::size_t max_call_depth { 4096 };
+  std::size_t max_vars { 0 };
+  std::size_t max_steps { 0 };
+  // bytes of all arrays, stacks and queues bound at once
+  std::size_t max_memory { 0 };
+  std::chrono::milliseconds timeout { 0 };
+
+  // Where runs of `main` take checkpoints, every `checkpoint_every` and when
+  //  `checkpoint::on_signal` asks for one. A forked copy of the process writes each
+  //  checkpoint while the run goes on, only one is written at a time.
+  std::string checkpoint_path;
+  std::chrono::milliseconds checkpoint_every { 0 };
+};
+
+// Thrown out of a run that exceeds one of the limits in `interpreter_options`.
+struct limit_exceeded : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+// An argument passed by the host of an embedded program: an integer, or for an array
+//  parameter its `length` elements at `data`, which the callee works on in place.
+struct host_arg
+{
+  std::uint64_t value { 0 };
+  void* data { nullptr };
+  std::size_t length { 0 };
+};
+
+// A program prepared once and run any number of times. Inverses, pure functions and
+//  the entry point are set up in the constructor, and runs reuse the interpreter, so its
+//  operand stack and the memo tables of pure functions carry over from run to run.
+class session
+{
+public:
+  session(const std::vector<std::unique_ptr<Fn>>& fns, const interpreter_options& opts = {});
+  ~session();
+
+  // Runs `main` with `read` taking numbers from `is` and `print` writing to `os`.
+  // A run that throws `limit_exceeded` or `run_error` leaves the session usable for the next one.
+  void run(std::istream& is, std::ostream& os);
+
+  // Like `run`, but calls `refuel` after every `fuel` steps, e.g. to suspend the run.
+  // It returns the fuel of the next slice. `fuel` 0 runs without slices.
+  void run(std::istream& is, std::ostream& os, std::size_t fuel, std::function<std::size_t()> refuel);
+
+  // Continues the run a checkpoint was taken of. Returns false, without running
+  //  anything, if the checkpoint can't be read or was taken of another program.
+  // Output of the run up to the checkpoint isn't repeated, `read` continues with `is`.
+  bool resume(const std::string& path, std::istream& is, std::ostream& os, std::ostream& err);
+
+  // Calls or uncalls `f` directly, with `read` and `print` bound to nothing. Returns
+  //  false, without running anything, if the arguments don't fit the parameters of `f`.
+  bool call(Fn* f, const host_arg* args, std::size_t n, bool uncall = false);
+
+  // Like `call` for each of `count` argument tuples, which `args` holds one after the
+  //  other. Returns false, without running anything, if one of them doesn't fit.
+  // Tuples run in lockstep, several at once, unless `f` or a function it calls uses
+  //  what lockstep doesn't cover or the arrays of the tuples overlap.
+  // Limits hold for each tuple like for `call`. Either way, once a tuple hits one or
+  //  fails, the tuples before it are done and its exception is thrown.
+  bool call_each(Fn* f, const host_arg* args, std::size_t count, bool uncall = false);
+
+  // steps executed by the current or last run
+  std::size_t steps() const;
+
+private:
+  void prepare(std::istream& is, std::ostream& os);
+  void run_main();
+
+  std::unique_ptr<Interpreter> interp;
+  interpreter_options opts;
+  Fn* main { nullptr };
+  std::uint64_t program { 0 };
+
+  // whether a function can run in lockstep, found out on its first `call_each`
+  std::map<const Fn*, bool> lockstep_fits;
+};
+
+void interpret(std::ostream& os, const std::vector<std::unique_ptr<Fn>>& n,
+               const interpreter_options& opts = {});
 
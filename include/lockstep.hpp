@@ -0,0 +1,30 @@
+#pragma once
+
+#include <interpret.hpp>
+#include <ast.hpp>
+
+#include <cstddef>
+#include <string>
+#include <map>
+
+// Runs one function over many argument tuples at once. Every integer variable holds one
+//  lane per tuple, and each node is evaluated once for all of them. Lanes that take
+//  another branch of an `if`, or leave a loop earlier, are masked off until they meet
+//  the others again, so all lanes always run the same statement.
+namespace lockstep
+{
+inline constexpr std::size_t lane_count = 8;
+
+// Whether `f` and everything it calls can run in lockstep. Stacks, queues, parallel
+//  loops, `print` and `read` can't, the lanes would need them one after the other.
+bool supports(Fn* f, const std::map<std::string, Fn*>& fns);
+
+// Calls or uncalls `f` for `count` tuples of `f->params.size()` arguments each, which
+//  fit the parameters, `lane_count` tuples at a time. Arrays are updated in place and
+//  must not overlap. Call depth and time are limited per group of tuples like for a
+//  single call, steps per tuple, counting the nodes evaluated while its lane is active.
+// Stops at the first group that hits a limit or fails, which is left untouched, and
+//  returns the number of tuples done before it.
+std::size_t run(Fn* f, const std::map<std::string, Fn*>& fns, const host_arg* args, std::size_t count,
+                bool uncall, const interpreter_options& opts);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <unordered_set>
+#include <cstdint>
+#include <vector>
+
+// Remembers the argument tuples a pure function already ran with, separately
+//  for calls and uncalls. Pure functions have no effect other than possibly
+//  failing an assertion, which is determined by the arguments as well. So a
+//  repeated call with a known tuple can be skipped altogether.
+class memo_table
+{
+public:
+  using Key = std::vector<std::size_t>;
+
+  // `budget` is the number of bytes left for all tables sharing it
+  explicit memo_table(std::size_t& budget)
+    : budget(budget)
+  {  }
+
+  bool lookup(const Key& args, bool uncall);
+  void insert(Key&& args, bool uncall);
+
+  std::size_t hits { 0 };
+  std::size_t misses { 0 };
+  std::size_t bytes { 0 };
+
+private:
+  struct key_hasher
+  {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  std::unordered_set<Key, key_hasher> seen[2];
+  std::size_t& budget;
+};
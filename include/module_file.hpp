@@ -0,0 +1,19 @@
+#pragma once
+
+#include <ast.hpp>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Version of the binary module layout, bumped on every incompatible change.
+constexpr std::uint32_t module_file_version = 3;
+
+// Writes checked and inferred functions as a binary module: interned symbols,
+//  types, flat nodes of every body and its precomputed inverse.
+bool write_module(std::ostream& os, const std::vector<Fn::Ptr>& fns);
+
+// Memory-maps a module written by `write_module`. Only the function table is
+//  read up front, bodies are materialized from the mapping on their first call.
+// Reports problems to `err` and returns no functions if the file is unusable.
+std::vector<Fn::Ptr> load_module(const std::string& path, std::ostream& err);
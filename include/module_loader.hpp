@@ -0,0 +1,77 @@
+#pragma once
+
+#include <ast.hpp>
+
+#include <stdexcept>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <map>
+
+// A parsed, inferred and verified module.
+struct checked_module
+{
+  std::string path;
+  std::vector<std::string> imports;
+  std::vector<Fn::Ptr> fns;
+
+  // errors of inference and verification, reported whenever the module is used
+  std::string diagnostics;
+  bool ok { true };
+};
+
+// Thrown by the first call of a lazily parsed function whose body fails the checks.
+struct check_failed : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+// Parsed modules keyed by path, content hash and whether they were parsed lazily, so a
+//  module imported from many places or loaded again by a long running process is only
+//  parsed once.
+class module_cache
+{
+public:
+  using Key = std::tuple<std::string, std::uint64_t, bool>;
+
+  std::shared_ptr<const checked_module> find(const Key& key);
+  void insert(const Key& key, std::shared_ptr<const checked_module> mod);
+
+  std::size_t hits { 0 };
+  std::size_t misses { 0 };
+
+  static module_cache& global();
+
+private:
+  std::mutex mut;
+  std::map<Key, std::shared_ptr<const checked_module>> modules;
+};
+
+// Resolves `import a.b` to `a/b.ral` in the main module's directory or in one of the
+//  search directories, and loads the transitive imports. Modules of the same depth
+//  in the import graph don't depend on each other and are parsed in parallel.
+// With `lazy`, function bodies are only parsed and checked when first called, see `parse_module`.
+class module_loader
+{
+public:
+  explicit module_loader(std::vector<std::string> search_path = {}, bool lazy = false,
+                         module_cache& cache = module_cache::global());
+
+  // Loads the module in `text`, located in directory `dir`, and everything it imports.
+  // Appends all functions to `out`, reports problems to `err`.
+  bool load_text(const std::string& text, const std::string& dir, std::vector<Fn::Ptr>& out, std::ostream& err);
+  bool load(const std::string& path, std::vector<Fn::Ptr>& out, std::ostream& err);
+
+private:
+  std::shared_ptr<const checked_module> check(const std::string& path, const std::string& text);
+  std::string resolve(const std::string& import, const std::string& root) const;
+  bool link(std::vector<std::shared_ptr<const checked_module>>&& mods, std::vector<Fn::Ptr>& out, std::ostream& err);
+
+private:
+  std::vector<std::string> search_path;
+  bool lazy;
+  module_cache& cache;
+};
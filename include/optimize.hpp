@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct Fn;
+
+// Swapping two whole variables only changes which variable holds which value. Within
+//  a block such swaps are removed by renaming the variables in the statements after
+//  them. Before statements that bind, unbind or call, and at the end of the block,
+//  the values are put back in place with as few swaps as possible.
+// Returns the number of swaps removed, swaps of array elements are kept.
+std::size_t rename_swaps(Fn& f);
+
+// Whole program pass from `main`: drops the functions no call can reach, and replaces
+//  calls and uncalls of small functions that don't recurse by their body or its inverse,
+//  with the parameters bound by `let` and `unlet` around it.
+// Returns the number of inlined calls.
+std::size_t inline_calls(std::vector<std::unique_ptr<Fn>>& fns);
+
+// Whole program pass from `main`: a call or uncall passing literals to integer parameters
+//  its callee, and everything the callee calls, never writes goes to a copy of the callee
+//  with the literals in place of these parameters, named like `f{n=5}`. Expressions,
+//  `if`s and loops of the copy that became constant are folded, and its calls are
+//  specialized in turn. `main` is specialized in place on the 0 it is always called with.
+// The copies add at most `budget` nodes to the program. Returns the number of copies.
+std::size_t specialize_calls(std::vector<std::unique_ptr<Fn>>& fns, std::size_t budget);
@@ -15,6 +15,15 @@
 #include <string>
 
 
+struct parsed_module
+{
+  // names of imported modules, `a.b` refers to `a/b.ral`
+  std::vector<std::string> imports;
+  std::vector<Fn::Ptr> fns;
+};
+
 std::vector<Fn::Ptr> read(std::string_view module);
 std::vector<Fn::Ptr> read_text(const std::string& str);
+// With `lazy`, the functions with a block as body only get a `loader` that parses it.
+parsed_module parse_module(const std::string& str, std::string_view name = "#TXT#", bool lazy = false);
 
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <iosfwd>
+
+// The phases a program goes through from its text to the end of its run, the passes
+//  among them that can be turned off, and what each phase costs when asked for.
+namespace passes
+{
+enum class phase : std::uint8_t
+{
+  lex,       // reading tokens, part of parsing
+  parse,
+  infer,
+  verify,
+  optimize,  // renaming swaps, specializing and inlining calls
+  prepare,   // inverses, purity and memo tables before the first run
+  run,
+};
+inline constexpr std::size_t phase_count = 7;
+
+std::string_view name(phase p);
+
+// `verify`, `rename-swaps`, `inline` and `specialize` can be turned off, the other phases always run.
+// Returns false for any other name.
+bool disable(std::string_view pass);
+bool enabled(std::string_view pass);
+
+// Costs are only measured after this, until then a `scope` is a load and a branch.
+void measure();
+bool measuring();
+
+// Allocations of the calling thread, counted by whoever replaces `operator new`.
+// The ral executable does, a program embedding ral reports none.
+struct allocation_count
+{
+  std::uint64_t allocations { 0 };
+  std::uint64_t bytes { 0 };
+};
+inline thread_local allocation_count allocated;
+
+inline void count_allocation(std::size_t bytes) noexcept
+{
+  ++allocated.allocations;
+  allocated.bytes += bytes;
+}
+
+// Charges the wall time and the allocations of the calling thread to `p` while alive.
+// A scope opened within another one pauses it, so every phase only counts its own work.
+// Phases running on several threads at once, e.g. loading modules, add up their times.
+class scope
+{
+public:
+  explicit scope(phase p);
+  ~scope();
+
+  scope(const scope&) = delete;
+  scope& operator=(const scope&) = delete;
+
+private:
+  void charge();
+
+  phase p;
+  bool active;
+  scope* outer { nullptr };
+  std::chrono::steady_clock::time_point since;
+  allocation_count at;
+};
+
+// Adds to what `p` produced: tokens for `lex`, evaluated nodes for `run` and the nodes
+//  of the bodies it worked on for every other phase.
+void add_nodes(phase p, std::size_t n);
+
+// One row per phase, or with `json` an object with an array of them.
+void report(std::ostream& os, bool json);
+}
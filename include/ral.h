@@ -0,0 +1,52 @@
+/* C interface for embedding ral, see embed.hpp for the C++ one. */
+#ifndef RAL_H
+#define RAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ral_program ral_program;
+typedef struct ral_function ral_function;
+
+/* An integer argument, or for an array parameter its `length` elements at `data`,
+ *  which the function reads and writes in place. */
+typedef struct ral_arg
+{
+  uint64_t value;
+  void* data;
+  size_t length;
+} ral_arg;
+
+/* Load a module and its imports, found next to it or in the `n` directories of
+ *  `search_path`. Return NULL on failure, see ral_error. */
+ral_program* ral_load(const char* path, const char* const* search_path, size_t n);
+ral_program* ral_load_text(const char* text, const char* const* search_path, size_t n);
+void ral_free(ral_program* p);
+
+/* The function called `name`, or NULL. Valid as long as its program. */
+ral_function* ral_find(ral_program* p, const char* name);
+
+/* Run `f` resp. its inverse. Return 0 on success, -1 if the arguments don't fit, a
+ *  limit was exceeded or the run failed, see ral_error. Calls of one program must not
+ *  overlap. */
+int ral_call(ral_program* p, ral_function* f, const ral_arg* args, size_t n);
+int ral_uncall(ral_program* p, ral_function* f, const ral_arg* args, size_t n);
+
+/* Like ral_call resp. ral_uncall for each of `count` argument tuples, which `args`
+ *  holds one after the other. Tuples whose arrays don't overlap run several at a time
+ *  if `f` allows. Nothing runs if one of the tuples doesn't fit. */
+int ral_call_each(ral_program* p, ral_function* f, const ral_arg* args, size_t count);
+int ral_uncall_each(ral_program* p, ral_function* f, const ral_arg* args, size_t count);
+
+/* What the last failing function of this thread reported. */
+const char* ral_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
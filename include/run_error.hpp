@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdexcept>
+
+// Thrown out of a run that breaks a rule only known while it runs, e.g. an `unlet` of
+//  another value, a division by zero or an index out of bounds. Like `limit_exceeded`
+//  it ends the run, not the process, and the session stays usable for the next one.
+struct run_error : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] inline void fail_run(const char* what)
+{ throw run_error(what); }
+
+// where the interpreter used to `assert`, the run fails with `what` instead
+inline void run_check(bool ok, const char* what)
+{
+  if(!ok)
+    fail_run(what);
+}
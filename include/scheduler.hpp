@@ -0,0 +1,71 @@
+#pragma once
+
+#include <interpret.hpp>
+#include <fiber.hpp>
+#include <ast.hpp>
+
+#include <condition_variable>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <deque>
+#include <mutex>
+
+// Runs many programs on a few threads. Every program gets slices of `slice` steps in
+//  round-robin order, after a slice it is suspended and queued behind all others, so
+//  a long program can't hold up short ones for more than a slice per thread.
+// A program stays on the thread that started it, so threads are balanced by which
+//  programs they start rather than slice by slice.
+class scheduler
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct stats
+  {
+    std::string name;
+    std::size_t slices { 0 };
+    std::size_t steps { 0 };
+
+    // time spent running slices, the longest slice and the longest wait for one
+    clock::duration busy { 0 };
+    clock::duration max_slice { 0 };
+    clock::duration max_wait { 0 };
+    clock::duration total { 0 };
+
+    std::string output;
+    std::string error;
+  };
+
+  scheduler(std::size_t threads, std::size_t slice, const interpreter_options& opts = {});
+  ~scheduler();
+
+  // Queues `fns` to run with `input` as what `read` sees.
+  void add(std::string name, std::vector<Fn::Ptr>&& fns, std::string input = {});
+
+  // Runs everything queued to completion.
+  void run();
+
+  const std::vector<stats>& results() const;
+  void report(std::ostream& os) const;
+
+private:
+  struct program;
+
+  void work(std::size_t self);
+
+private:
+  std::size_t threads;
+  std::size_t slice;
+  interpreter_options opts;
+
+  std::vector<std::unique_ptr<program>> programs;
+  std::vector<stats> finished;
+
+  std::mutex mut;
+  std::condition_variable ready_cv;
+  std::deque<program*> ready;
+  std::size_t running { 0 };
+};
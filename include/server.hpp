@@ -0,0 +1,22 @@
+#pragma once
+
+#include <ast.hpp>
+#include <interpret.hpp>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Serves runs of one prepared program on the Unix domain socket at `path`.
+// A client writes the program's input and shuts down its sending side, the server
+//  runs `main` on it and answers with everything the program printed, then closes.
+// The answer starts with a line `STATUS LENGTH`, STATUS is 1 if the run failed and
+//  LENGTH the size of the output. A failed run's error message follows its output,
+//  e.g. one exceeding a limit of `opts`.
+// Returns only if the socket can't be set up, after reporting to `err`.
+int serve(const std::string& path, const std::vector<Fn::Ptr>& fns,
+          const interpreter_options& opts, std::ostream& err);
+
+// Sends `is` as one run to the server at `path` and copies its output to `os` and its
+//  error, if any, to `err`. Returns 1 if the run failed.
+int request(const std::string& path, std::istream& is, std::ostream& os, std::ostream& err);
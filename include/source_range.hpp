@@ -2,6 +2,9 @@
 
 #include <cstdint>
 #include <ostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 struct untied_source_pos
 {
@@ -44,4 +47,33 @@ struct source_range
 
 source_range operator+(const source_range& left, const source_range& right);
 
+// A parsed module and the byte offset of each of its lines.
+struct source_file
+{
+  std::string name;
+  std::vector<std::uint32_t> line_starts;
+};
+
+// Compact location, a byte offset into a module registered with the `source_map`.
+// Row and column are only computed when a location is printed.
+struct source_loc
+{
+  std::uint32_t offset { 0 };
+  std::uint32_t file { 0 };
+
+  // the range views the name of the module, which lives as long as its entry
+  source_range resolve() const;
+  std::string to_string() const;
 
+  friend std::ostream& operator<<(std::ostream& os, const source_loc& loc);
+};
+
+namespace source_map
+{
+  // Registers a module, its parser fills in the line starts while reading. The entry
+  //  lives as long as the returned pointer, held by the parser and by the loaders of
+  //  lazily parsed bodies, then `id` goes to the next module.
+  std::shared_ptr<source_file> add(std::string_view name, std::uint32_t& id);
+
+  std::shared_ptr<const source_file> get(std::uint32_t id);
+}
@@ -6,21 +6,26 @@
 #include <memory>
 #include <vector>
 #include <iosfwd>
+#include <string>
+#include <mutex>
 
+// Opens module streams by name. The same module may be opened several times
+//  at once, e.g. by parsers running in parallel, each gets its own stream.
 struct stream_lookup_t
 {
   stream_lookup_t();
   ~stream_lookup_t();
 
   std::istream& operator[](std::string_view str);
-  void drop(std::string_view str);
+  void drop(std::string_view str, std::istream& is);
 
 private:
   void process_stdin();
+  std::string resolve(std::string_view str);
 private:
-  std::vector<std::unique_ptr<std::ifstream>> files;
+  std::mutex mut;
 
-  std::unordered_map<std::string_view, std::vector<std::unique_ptr<std::ifstream>>::iterator> map;
+  std::unordered_map<std::string, std::vector<std::unique_ptr<std::ifstream>>> map;
 
   std::string stdin_module;
 
@@ -28,4 +33,3 @@ private:
 };
 
 inline stream_lookup_t stream_lookup;
-
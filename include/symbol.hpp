@@ -27,9 +27,13 @@ struct symbol
   const std::string& str() const;
   std::uint_fast64_t hash() const;
 private:
-  static std::string& lookup_or_emplace(std::uint_fast64_t hash, const char* str);
+  // the key of `str`, interned first if it is new
+  static std::uint_fast64_t lookup_or_emplace(std::uint_fast64_t hash, const char* str);
+  static const std::string& lookup(std::uint_fast64_t hash);
 private:
-  static tsl::robin_map<std::uint_fast64_t, std::string> symbols;
+  // Shared by all threads. The strings themselves never move once interned,
+  //  so references handed out stay valid while the table grows.
+  static tsl::robin_map<std::uint_fast64_t, const std::string*> symbols;
 
   std::uint_fast64_t hash_;
 };
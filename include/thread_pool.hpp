@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <deque>
+#include <mutex>
+
+// Work-stealing thread pool. Every worker owns a deque, it pops its own work
+//  from the back and steals from the front of the others when it runs dry.
+// Threads waiting for a `parallel_for` keep executing tasks, so nesting is fine, and
+//  sleep once there is nothing left to take.
+class thread_pool
+{
+public:
+  using Task = std::function<void()>;
+
+  explicit thread_pool(std::size_t threads);
+  ~thread_pool();
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  // Runs `f(beg', end')` on disjoint chunks covering [beg, end) and blocks until all are done.
+  void parallel_for(std::size_t beg, std::size_t end, std::size_t grain,
+                    const std::function<void(std::size_t, std::size_t)>& f);
+
+  // number of threads that execute tasks, including the one calling `parallel_for`
+  std::size_t size() const
+  { return workers.size() + 1; }
+
+  // Pool shared by the interpreter, sized with `set_threads` before first use.
+  static thread_pool& global();
+  static void set_threads(std::size_t threads);
+
+  // whether any pool runs threads of its own, which a forked process doesn't have
+  static bool spawned_threads();
+
+private:
+  struct queue
+  {
+    std::mutex mut;
+    std::deque<Task> tasks;
+  };
+
+  void push(std::size_t q, Task&& task);
+  bool try_run(std::size_t self);
+  void work(std::size_t self);
+
+private:
+  std::vector<std::unique_ptr<queue>> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex sleep_mut;
+  std::condition_variable wakeup;
+  std::atomic<std::size_t> pending { 0 };
+  std::atomic<bool> stop { false };
+};
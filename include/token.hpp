@@ -17,8 +17,8 @@ std::string_view kind_to_str(token_kind kind);
 class token
 {
 public:
-  token(token_kind kind, symbol data, source_range range)
-    : kind(kind), data(data), loc(range)
+  token(token_kind kind, symbol data, source_loc loc)
+    : kind(kind), data(data), loc(loc)
   {  }
 
   token()
@@ -27,6 +27,6 @@ public:
 
   token_kind kind;
   symbol data;
-  source_range loc;
+  source_loc loc;
 };
 
@@ -30,6 +30,8 @@ TOK(GreaterEqual, ">=", 7)
 TOK(Greater, ">", '>')
 TOK(LParen, "(", '(')
 TOK(RParen, ")", ')')
+TOK(LBracket, "[", '[')
+TOK(RBracket, "]", ']')
 TOK(LBrace, "{", '{')
 TOK(RBrace, "}", '}')
 TOK(Undef, "#undef#", 1)
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <iosfwd>
+#include <memory>
+
+// Execution trace of the interpreter, for looking into runs that misbehave or are slow.
+// Every thread writes fixed-size binary events into a ring buffer of its own, so
+//  recording is a store and an increment, and only the most recent events are kept.
+// The buffers are written to a file on exit or when a signal asks for it, and
+//  `ral-trace` turns such a file back into text.
+namespace trace
+{
+enum class event_kind : std::uint32_t
+{
+  call,
+  call_exit,
+  uncall,
+  uncall_exit,
+  iteration,
+  do_begin,
+  yield,
+  undo,
+  let,
+  unlet,
+};
+
+// `id` is the slot of the variable or function name involved, `step` the number of
+//  nodes the interpreter of the thread has evaluated in its current run.
+struct event
+{
+  std::uint64_t step;
+  std::uint64_t value;
+  std::uint32_t id;
+  event_kind kind;
+};
+
+// An event in its ring. `dump` copies it while the owner may be overwriting it, so every
+//  field is accessed atomically, relaxed loads and stores cost what plain ones do.
+struct stored_event
+{
+  void store(const event& e)
+  {
+    step.store(e.step, std::memory_order_relaxed);
+    value.store(e.value, std::memory_order_relaxed);
+    id.store(e.id, std::memory_order_relaxed);
+    kind.store(e.kind, std::memory_order_relaxed);
+  }
+
+  event load() const
+  {
+    return { step.load(std::memory_order_relaxed), value.load(std::memory_order_relaxed),
+             id.load(std::memory_order_relaxed), kind.load(std::memory_order_relaxed) };
+  }
+
+  std::atomic<std::uint64_t> step { 0 };
+  std::atomic<std::uint64_t> value { 0 };
+  std::atomic<std::uint32_t> id { 0 };
+  std::atomic<event_kind> kind { event_kind::call };
+};
+
+struct ring
+{
+  explicit ring(std::size_t capacity, std::uint32_t thread);
+
+  std::unique_ptr<stored_event[]> events;
+  std::size_t mask;
+  std::uint32_t thread;
+
+  // events ever written, the last `mask + 1` of them are still there
+  std::atomic<std::uint64_t> head { 0 };
+};
+
+// Starts tracing with rings of `capacity` events, rounded up to a power of two.
+void enable(std::size_t capacity);
+bool enabled();
+
+// the ring of the calling thread, created on first use
+ring& local();
+
+inline void record(event_kind kind, std::uint32_t id, std::uint64_t value, std::uint64_t step)
+{
+  static thread_local ring* mine = nullptr;
+  if(!mine)
+    mine = &local();
+
+  const auto h = mine->head.load(std::memory_order_relaxed);
+  // `dump` seeing any of the stores below also sees the head of the previous event
+  std::atomic_thread_fence(std::memory_order_release);
+  mine->events[h & mine->mask].store(event { step, value, id, kind });
+  mine->head.store(h + 1, std::memory_order_release);
+}
+
+// Writes all rings and the names their events refer to to `path`.
+bool dump(const std::string& path, std::ostream& err);
+
+// After `signal` arrives, the next interpreter to look dumps to `path` and carries on.
+void dump_on_signal(int signal, const std::string& path);
+void poll();
+
+// Prints the events of a dump, oldest first for every thread.
+bool decode(std::istream& is, std::ostream& os, std::ostream& err);
+}
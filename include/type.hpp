@@ -6,7 +6,14 @@
 
 enum class TypeKind {
   Unit,
-  Int,
+  I8,
+  I16,
+  I32,
+  I64,
+  U64,
+  Array,
+  Stack,
+  Queue,
   Ptr,
   Fn,
 };
@@ -20,23 +27,45 @@ struct Type {
     static std::vector<Type::Ptr> params(Type::Ptr fn);
   };
 
-  Type(TypeKind kind, std::vector<Type::Ptr>&& args)
+  struct Array
+  {
+    static Type::Ptr elem(Type::Ptr arr);
+    static std::size_t length(Type::Ptr arr);
+  };
+
+  // `stack<T>` and `queue<T>`
+  struct Container
+  {
+    static Type::Ptr elem(Type::Ptr c);
+  };
+
+  Type(TypeKind kind, std::vector<Type::Ptr>&& args, std::size_t length = 0)
     : kind(kind)
     , args(std::move(args))
+    , length(length)
   {  }
 
   TypeKind kind;
   std::vector<Type::Ptr> args;
+
+  // number of elements of an array type
+  std::size_t length;
 };
 
 
 Type::Ptr str2typ(const std::string& str);
 
 Type::Ptr unit_type();
-Type::Ptr int_type();
+// `int` is the unsigned 64 bit integer
+Type::Ptr int_type(TypeKind kind = TypeKind::U64);
+Type::Ptr array_type(Type::Ptr&& elem, std::size_t length);
+Type::Ptr container_type(TypeKind kind, Type::Ptr&& elem);
 Type::Ptr fn_type(std::vector<Type::Ptr>&& params, Type::Ptr&& ret);
 
 bool is_int(Type& typ);
+bool is_int(TypeKind kind);
+bool is_array(const Type::Ptr& typ);
+bool is_container(const Type::Ptr& typ);
 
 struct Fn;
 void infer(Fn* n);
@@ -0,0 +1,20 @@
+#include <passes.hpp>
+
+#include <cstdlib>
+#include <new>
+
+// Every allocation of the ral executable is counted for --time-phases. Kept apart from
+//  the code allocating, so that the replacements aren't inlined into it.
+void* operator new(std::size_t n)
+{
+  passes::count_allocation(n);
+  if(void* p = std::malloc(n != 0 ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{ std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept
+{ std::free(p); }
@@ -0,0 +1,513 @@
+#include <analysis.hpp>
+#include <type.hpp>
+#include <ast.hpp>
+
+#include <algorithm>
+#include <ostream>
+#include <cassert>
+#include <map>
+
+static const std::string& name_of(const Node* n)
+{
+  // the place of an array element is its array
+  if(n->kind == NodeKind::Index)
+    n = n->lhs[0].get();
+  assert(n->kind == NodeKind::Var);
+  return std::get<Object>(n->data).name;
+}
+
+static void collect(const Node* n, effects& eff)
+{
+  if(!n)
+    return;
+
+  switch(n->kind)
+  {
+  default:
+    for(auto& x : n->lhs)
+      collect(x.get(), eff);
+    return;
+
+  case NodeKind::Var:
+    eff.reads.insert(name_of(n));
+    return;
+
+  case NodeKind::OpEq:
+  case NodeKind::Swap:
+  case NodeKind::Push:
+  case NodeKind::Pop:
+    for(auto& x : n->lhs)
+      collect(x.get(), eff);
+    eff.writes.insert(name_of(n->lhs[0].get()));
+    if(n->kind != NodeKind::OpEq)
+      eff.writes.insert(name_of(n->lhs[1].get()));
+    return;
+
+  case NodeKind::Let:
+  case NodeKind::Unlet:
+    collect(n->lhs[1].get(), eff);
+    eff.writes.insert(name_of(n->lhs[0].get()));
+    if(n->kind == NodeKind::Let)
+      eff.locals.insert(name_of(n->lhs[0].get()));
+    return;
+
+  case NodeKind::Call:
+  case NodeKind::Uncall:
+    eff.callees.insert(name_of(n->lhs[1].get()));
+    eff.writes.insert(name_of(n->lhs[0].get()));
+    eff.locals.insert(name_of(n->lhs[0].get()));
+    for(std::size_t i = 2; i < n->lhs.size(); ++i)
+    {
+      collect(n->lhs[i].get(), eff);
+      // arrays, stacks and queues are passed by reference, the callee may change them
+      if(n->lhs[i]->kind == NodeKind::Var && (is_array(n->lhs[i]->typ) || is_container(n->lhs[i]->typ)))
+        eff.writes.insert(name_of(n->lhs[i].get()));
+    }
+    return;
+
+  case NodeKind::ParFor:
+    eff.locals.insert(name_of(n->lhs[0].get()));
+    for(std::size_t i = 1; i < n->lhs.size(); ++i)
+      collect(n->lhs[i].get(), eff);
+    return;
+  }
+}
+
+effects effects_of(const Node* n)
+{
+  effects eff;
+  collect(n, eff);
+  return eff;
+}
+
+std::size_t cost_of(const Node* n)
+{
+  if(!n)
+    return 0;
+
+  std::size_t c = 1;
+  for(auto& x : n->lhs)
+    c += cost_of(x.get());
+  if(n->kind == NodeKind::Loop || n->kind == NodeKind::ParFor)
+    c *= 16;
+  return c;
+}
+
+static void array_lengths(const Node* n, std::map<std::string, std::size_t>& lengths)
+{
+  if(!n)
+    return;
+  if(n->kind == NodeKind::Var && is_array(n->typ))
+    lengths[name_of(n)] = n->typ->length;
+  for(auto& x : n->lhs)
+    array_lengths(x.get(), lengths);
+}
+
+static void containers(const Node* n, std::set<std::string>& names)
+{
+  if(!n)
+    return;
+  if(n->kind == NodeKind::Var && is_container(n->typ))
+    names.insert(name_of(n));
+  for(auto& x : n->lhs)
+    containers(x.get(), names);
+}
+
+undo_plan plan_undo(const Node* n)
+{
+  assert(n->kind == NodeKind::DoYieldUndo);
+  auto s1 = effects_of(n->lhs[0].get());
+  auto s2 = effects_of(n->lhs[1].get());
+
+  undo_plan plan;
+  if(!s1.callees.empty())
+    return plan;
+  for(auto& c : s2.callees)
+    if(c != "print" && c != "read")
+      return plan;
+  for(auto& v : s2.writes)
+    if(s1.writes.count(v) || s1.reads.count(v))
+      return plan;
+
+  // the size of a stack or queue isn't known up front, it is always popped back
+  std::set<std::string> grown;
+  containers(n->lhs[0].get(), grown);
+  for(auto& v : grown)
+    if(s1.writes.count(v))
+      return plan;
+
+  // saving and restoring moves a word per scalar and 8 bytes of every array at once
+  std::map<std::string, std::size_t> lengths;
+  array_lengths(n->lhs[0].get(), lengths);
+  std::size_t restore_cost = 0;
+  for(auto& v : s1.writes)
+  {
+    auto it = lengths.find(v);
+    restore_cost += 2 * (it == lengths.end() ? 1 : 1 + it->second / 8);
+  }
+
+  plan.restore = restore_cost < cost_of(n->lhs[0].get());
+  if(plan.restore)
+    plan.writes.assign(s1.writes.begin(), s1.writes.end());
+  return plan;
+}
+
+block_plan plan_block(const Node* block, const std::set<std::string>& pure,
+                      const std::map<std::string, Fn*>& fns, std::size_t min_cost)
+{
+  assert(block->kind == NodeKind::Block);
+  const std::size_t n = block->lhs.size();
+
+  std::vector<effects> effs;
+  std::vector<std::size_t> costs;
+  std::vector<bool> barrier;
+  for(auto& s : block->lhs)
+  {
+    effs.emplace_back(effects_of(s.get()));
+    costs.emplace_back(cost_of(s.get()));
+
+    // impure callees could touch any variable of ours, I/O has to stay in order
+    bool b = false;
+    for(auto& c : effs.back().callees)
+    {
+      auto f = fns.find(c);
+      b = b || !pure.count(c) || f == fns.end();
+      if(!b)
+        costs.back() += cost_of(f->second->body.get());
+    }
+    barrier.push_back(b);
+  }
+
+  auto intersects = [](const std::set<std::string>& a, const std::set<std::string>& b)
+  {
+    for(auto& x : a)
+      if(b.count(x))
+        return true;
+    return false;
+  };
+  auto conflict = [&](std::size_t i, std::size_t j)
+  {
+    return intersects(effs[i].writes, effs[j].writes)
+        || intersects(effs[i].writes, effs[j].reads)
+        || intersects(effs[i].reads, effs[j].writes);
+  };
+
+  block_plan plan;
+  for(std::size_t beg = 0; beg < n; )
+  {
+    if(barrier[beg])
+    {
+      plan.stages.emplace_back(block_plan::stage { block_plan::group { { beg }, effs[beg].writes, costs[beg] } });
+      ++beg;
+      continue;
+    }
+    std::size_t end = beg;
+    while(end < n && !barrier[end])
+      ++end;
+
+    // connected components of the conflict graph, via union-find
+    std::vector<std::size_t> parent(end - beg);
+    for(std::size_t i = 0; i < parent.size(); ++i)
+      parent[i] = i;
+    auto find = [&](std::size_t i)
+    {
+      while(parent[i] != i)
+        i = parent[i] = parent[parent[i]];
+      return i;
+    };
+    for(std::size_t i = beg; i < end; ++i)
+      for(std::size_t j = i + 1; j < end; ++j)
+        if(conflict(i, j))
+          parent[find(j - beg)] = find(i - beg);
+
+    // groups keep the statements in their original order
+    block_plan::stage st;
+    std::map<std::size_t, std::size_t> group_of;
+    for(std::size_t i = beg; i < end; ++i)
+    {
+      auto [it, fresh] = group_of.emplace(find(i - beg), st.size());
+      if(fresh)
+        st.emplace_back();
+      auto& g = st[it->second];
+      g.stmts.push_back(i);
+      g.writes.insert(effs[i].writes.begin(), effs[i].writes.end());
+      g.cost += costs[i];
+    }
+    plan.parallel = plan.parallel
+      || std::count_if(st.begin(), st.end(), [min_cost](auto& g) { return g.cost >= min_cost; }) >= 2;
+    plan.stages.emplace_back(std::move(st));
+    beg = end;
+  }
+  return plan;
+}
+
+std::set<const Fn*> pure_functions(const std::vector<std::unique_ptr<Fn>>& fns)
+{
+  std::map<std::string, const Fn*> by_name;
+  std::map<const Fn*, effects> effs;
+  std::set<const Fn*> pure;
+
+  for(auto& f : fns)
+  {
+    by_name[f->name] = f.get();
+
+    // compiled modules come with their purity, lazily parsed functions are impure
+    if(f->pure)
+    {
+      if(*f->pure)
+        pure.insert(f.get());
+      continue;
+    }
+    f->load();
+
+    auto& eff = effs[f.get()] = effects_of(f->body.get());
+    bool candidate = true;
+    for(auto& p : f->params)
+      candidate = candidate && !is_array(p.type) && !is_container(p.type);
+
+    // everything touched must be bound by the function itself
+    for(auto* vs : { &eff.reads, &eff.writes })
+      for(auto& v : *vs)
+      {
+        bool bound = eff.locals.count(v) != 0;
+        for(auto& p : f->params)
+          bound = bound || p.name == v;
+        candidate = candidate && bound;
+      }
+
+    if(candidate)
+      pure.insert(f.get());
+  }
+
+  // drop functions calling impure ones until nothing changes, recursion stays pure
+  for(bool changed = true; changed; )
+  {
+    changed = false;
+    for(auto it = pure.begin(); it != pure.end(); )
+    {
+      bool ok = true;
+      for(auto& c : effs[*it].callees)
+      {
+        auto callee = by_name.find(c);
+        ok = ok && callee != by_name.end() && pure.count(callee->second);
+      }
+      if(ok)
+        ++it;
+      else
+      {
+        it = pure.erase(it);
+        changed = true;
+      }
+    }
+  }
+  return pure;
+}
+
+// Iterations of `par i from E₁ to E₂ do S` run in any order and concurrently. So `S` may
+//  only write variables it binds itself and array elements at index `i`, only unlet
+//  variables it binds itself, and must not read elements of those arrays at any other index.
+struct par_checker
+{
+  par_checker(const Node* par, std::ostream& err)
+    : err(err)
+    , idx(name_of(par->lhs[0].get()))
+  {  }
+
+  void fail(const std::string& msg)
+  {
+    err << "error: " << msg << " in parallel loop over `" << idx << "`\n";
+    ok = false;
+  }
+
+  bool is_local(const std::string& name) const
+  { return locals.count(name) != 0; }
+
+  bool at_idx(const Node* index) const
+  {
+    auto& e = index->lhs[1];
+    return e->kind == NodeKind::Var && name_of(e.get()) == idx;
+  }
+
+  void read(const Node* n)
+  {
+    switch(n->kind)
+    {
+    default:
+      for(auto& x : n->lhs)
+        read(x.get());
+      return;
+
+    case NodeKind::Var:
+      if(is_array(n->typ) && !is_local(name_of(n)))
+        shared_reads.insert(name_of(n));
+      return;
+
+    case NodeKind::Index:
+      if(!at_idx(n) && !is_local(name_of(n)))
+        shared_reads.insert(name_of(n));
+      read(n->lhs[1].get());
+      return;
+    }
+  }
+
+  void write(const Node* place)
+  {
+    auto& name = name_of(place);
+    if(name == idx)
+      fail("assignment to the loop index");
+    else if(is_local(name))
+      return;
+    else if(place->kind == NodeKind::Index && at_idx(place))
+      elem_writes.insert(name);
+    else
+      fail("write to shared variable `" + name + "`");
+
+    if(place->kind == NodeKind::Index)
+      read(place->lhs[1].get());
+  }
+
+  void stmt(const Node* n)
+  {
+    switch(n->kind)
+    {
+    default:
+      for(auto& x : n->lhs)
+        stmt(x.get());
+      return;
+
+    case NodeKind::Var:
+    case NodeKind::Index:
+    case NodeKind::Cmp:
+    case NodeKind::Arith:
+      read(n);
+      return;
+
+    case NodeKind::OpEq:
+      write(n->lhs[0].get());
+      read(n->lhs[1].get());
+      return;
+
+    case NodeKind::Swap:
+    case NodeKind::Push:
+    case NodeKind::Pop:
+      write(n->lhs[0].get());
+      write(n->lhs[1].get());
+      return;
+
+    case NodeKind::Let:
+    case NodeKind::Unlet:
+    {
+      auto& name = name_of(n->lhs[0].get());
+      if(name == idx)
+        fail("rebinding of the loop index");
+      // every iteration would unbind the one variable the others still use
+      else if(n->kind == NodeKind::Unlet && !is_local(name))
+        fail("unlet of shared variable `" + name + "`");
+      read(n->lhs[1].get());
+      locals.insert(name);
+      if(n->kind == NodeKind::Let)
+        bound.insert(name);
+      else
+        bound.erase(name);
+      return;
+    }
+
+    case NodeKind::If:
+    {
+      // a variable bound on either path may still be bound afterwards
+      read(n->lhs[0].get());
+      auto before = bound;
+      stmt(n->lhs[1].get());
+      std::swap(before, bound);
+      if(n->lhs.size() > 2)
+        stmt(n->lhs[2].get());
+      bound.insert(before.begin(), before.end());
+      if(n->lhs.size() > 3)
+        read(n->lhs[3].get());
+      return;
+    }
+
+    case NodeKind::DoYieldUndo:
+    {
+      // the undo takes back every binding of the first part
+      auto before = bound;
+      stmt(n->lhs[0].get());
+      auto done = bound;
+      stmt(n->lhs[1].get());
+      for(auto& v : done)
+        if(!before.count(v))
+          bound.erase(v);
+      for(auto& v : before)
+        if(!done.count(v))
+          bound.insert(v);
+      return;
+    }
+
+    case NodeKind::ParFor:
+      locals.insert(name_of(n->lhs[0].get()));
+      read(n->lhs[1].get());
+      read(n->lhs[2].get());
+      stmt(n->lhs[3].get());
+      return;
+
+    case NodeKind::Call:
+    case NodeKind::Uncall:
+      fail("call of `" + name_of(n->lhs[1].get()) + "`");
+      return;
+    }
+  }
+
+  bool check(const Node* par)
+  {
+    stmt(par->lhs[3].get());
+
+    // a worker's bindings die with it, so the next iteration would only fail on some
+    //  thread counts
+    for(auto& v : bound)
+      fail("`" + v + "` is still bound at the end of an iteration");
+
+    for(auto& arr : elem_writes)
+      if(shared_reads.count(arr))
+        fail("array `" + arr + "` is written at the loop index but read elsewhere");
+
+    // the bounds must still evaluate to the same range when running backwards
+    for(std::size_t i = 1; i < 3; ++i)
+      for(auto& v : effects_of(par->lhs[i].get()).reads)
+        if(elem_writes.count(v))
+          fail("bound depends on `" + v + "`, which is written");
+    return ok;
+  }
+
+  std::ostream& err;
+  std::string idx;
+
+  std::set<std::string> locals;
+  std::set<std::string> bound;
+  std::set<std::string> elem_writes;
+  std::set<std::string> shared_reads;
+
+  bool ok { true };
+};
+
+static bool verify(const Node* n, std::ostream& err)
+{
+  if(!n)
+    return true;
+
+  bool ok = true;
+  if(n->kind == NodeKind::ParFor)
+    ok = par_checker(n, err).check(n);
+
+  for(auto& x : n->lhs)
+    ok = verify(x.get(), err) && ok;
+  return ok;
+}
+
+bool verify(const Fn* f, std::ostream& err)
+{
+  if(verify(f->body.get(), err))
+    return true;
+
+  err << "note: in function `" << f->name << "`\n";
+  return false;
+}
@@ -0,0 +1,92 @@
+#include <array.hpp>
+#include <run_error.hpp>
+
+#include <algorithm>
+#include <limits>
+
+array_value::array_value(TypeKind elem, std::size_t length)
+  : elem(elem)
+  , length(length)
+  , width(int_ops_for(elem).width)
+  , owned(new std::byte[array_bytes(elem, length)]())
+  , data(owned.get())
+{  }
+
+array_value::array_value(TypeKind elem, std::size_t length, void* borrowed)
+  : elem(elem)
+  , length(length)
+  , width(int_ops_for(elem).width)
+  , owned()
+  , data(static_cast<std::byte*>(borrowed))
+{  }
+
+std::size_t array_bytes(TypeKind elem, std::size_t length)
+{
+  const auto width = int_ops_for(elem).width;
+  return length > std::numeric_limits<std::size_t>::max() / width ? std::numeric_limits<std::size_t>::max() : length * width;
+}
+
+std::size_t array_value::load(std::size_t idx) const
+{
+  run_check(idx < length, "Array index out of bounds.");
+  return visit_int_kind(elem, [this, idx](auto t) {
+      return array_kernel<decltype(t)>::load(data, idx);
+    });
+}
+
+void array_value::store(std::size_t idx, std::size_t cell)
+{
+  run_check(idx < length, "Array index out of bounds.");
+  visit_int_kind(elem, [this, idx, cell](auto t) {
+      array_kernel<decltype(t)>::store(data, idx, cell);
+    });
+}
+
+void array_value::update(BinOpTypes op, const array_value& rhs)
+{
+  run_check(elem == rhs.elem && length == rhs.length, "Arrays must have the same type.");
+  run_check(data != rhs.data, "Element-wise update of an array with itself is not reversible.");
+
+  visit_int_kind(elem, [this, op, &rhs](auto t) {
+      array_kernel<decltype(t)>::update(op, data, rhs.data, length);
+    });
+}
+
+void array_value::update(BinOpTypes op, std::size_t scalar)
+{
+  visit_int_kind(elem, [this, op, scalar](auto t) {
+      array_kernel<decltype(t)>::update(op, data, scalar, length);
+    });
+}
+
+void array_value::swap(array_value& rhs)
+{
+  run_check(elem == rhs.elem && length == rhs.length, "Arrays must have the same type.");
+  if(data == rhs.data)
+    return;
+
+  visit_int_kind(elem, [this, &rhs](auto t) {
+      array_kernel<decltype(t)>::swap(data, rhs.data, length);
+    });
+}
+
+void array_value::fill(std::size_t cell)
+{
+  for(std::size_t i = 0; i < length; ++i)
+    store(i, cell);
+}
+
+bool array_value::all_equal(std::size_t cell) const
+{
+  cell = int_ops_for(elem).normalize(cell);
+  for(std::size_t i = 0; i < length; ++i)
+    if(load(i) != cell)
+      return false;
+  return true;
+}
+
+bool array_value::operator==(const array_value& rhs) const
+{
+  return elem == rhs.elem && length == rhs.length
+      && std::equal(data, data + bytes(), rhs.data);
+}
@@ -1,5 +1,40 @@
 #include <ast.hpp>
+
+#include <unordered_map>
+#include <shared_mutex>
 #include <cassert>
+#include <mutex>
+
+static std::shared_mutex slot_mutex;
+static std::unordered_map<std::string, std::uint32_t> slots;
+static std::vector<std::string> names;
+
+std::uint32_t slot_of(const std::string& name)
+{
+  {
+    std::shared_lock<std::shared_mutex> lock(slot_mutex);
+    auto it = slots.find(name);
+    if(it != slots.end())
+      return it->second;
+  }
+  std::unique_lock<std::shared_mutex> lock(slot_mutex);
+  auto [it, fresh] = slots.emplace(name, static_cast<std::uint32_t>(slots.size()));
+  if(fresh)
+    names.emplace_back(name);
+  return it->second;
+}
+
+std::uint32_t slot_count()
+{
+  std::shared_lock<std::shared_mutex> lock(slot_mutex);
+  return static_cast<std::uint32_t>(slots.size());
+}
+
+std::string slot_name(std::uint32_t slot)
+{
+  std::shared_lock<std::shared_mutex> lock(slot_mutex);
+  return slot < names.size() ? names[slot] : std::string();
+}
 
 std::string_view Node::kind_to_str(NodeKind kind)
 {
@@ -8,3 +43,170 @@ std::string_view Node::kind_to_str(NodeKind kind)
   return "undef";
 }
 
+Node::Ptr clone(const Node* n)
+{
+  if(!n)
+    return nullptr;
+
+  std::vector<Node::Ptr> args;
+  args.reserve(n->lhs.size());
+  for(auto& x : n->lhs)
+    args.emplace_back(clone(x.get()));
+
+  auto k = n->kind;
+  auto d = n->data;
+  auto res = make_node(std::move(k), std::move(d), std::move(args));
+  res->typ = n->typ;
+  return res;
+}
+
+Fn::Ptr clone(const Fn& f)
+{
+  auto name = f.name;
+  auto params = f.params;
+  auto typ = f.typ;
+  auto res = std::make_unique<Fn>(std::move(name), std::move(params), std::move(typ), clone(f.body.get()));
+  res->inv_body = clone(f.inv_body.get());
+  res->pure = f.pure;
+  // a body that isn't loaded yet is loaded by the copy on its own
+  if(!f.body)
+    res->loader = f.loader;
+  return res;
+}
+
+std::size_t node_count(const Node* n)
+{
+  if(!n)
+    return 0;
+
+  std::size_t count = 1;
+  for(auto& x : n->lhs)
+    count += node_count(x.get());
+  return count;
+}
+
+static Node::Ptr invert_untyped(const Node* n)
+{
+  switch(n->kind)
+  {
+  case NodeKind::Num:
+  case NodeKind::Unit:
+  case NodeKind::Var:
+  case NodeKind::Index:
+
+  case NodeKind::Cmp:
+  case NodeKind::Arith:
+  case NodeKind::Swap:
+  case NodeKind::Size:
+  case NodeKind::Top:
+
+  case NodeKind::Uncall:
+  case NodeKind::Call:  // <- TODO! We need an UNCALL
+  {
+    auto k = n->kind == NodeKind::Call   ? NodeKind::Uncall 
+           :(n->kind == NodeKind::Uncall ? NodeKind::Call
+                                         : n->kind);
+    auto d = n->data;
+
+    std::vector<Node::Ptr> l;
+    for(auto& x : n->lhs)
+      l.emplace_back(invert(x.get()));
+    return make_node(std::move(k), std::move(d), std::move(l));
+  }
+  case NodeKind::Loop:
+  case NodeKind::Block:
+  {
+    auto k = n->kind;
+    std::vector<Node::Ptr> stmts;
+    for(auto& x : n->lhs)
+      stmts.emplace(stmts.begin(), invert(x.get()));
+    return make_node(std::move(k), std::move(stmts));
+  }
+  case NodeKind::ParFor:
+  {
+    // iterations are independent, so only the body needs to be reversed
+    std::vector<Node::Ptr> args;
+    for(std::size_t i = 0; i < 3; ++i)
+      args.emplace_back(invert(n->lhs[i].get()));
+    args.emplace_back(invert(n->lhs[3].get()));
+    return make_node(NodeKind::ParFor, std::move(args));
+  }
+  case NodeKind::DoYieldUndo:
+  {
+    // do S₁ yield S₂ undo  is undone by  do S₁ yield S₂⁻¹ undo
+    return make_node(NodeKind::DoYieldUndo, clone(n->lhs[0].get()), invert(n->lhs[1].get()));
+  }
+  case NodeKind::Stmt:
+  {
+    auto ex = invert(n->lhs[0].get());
+    return make_node(NodeKind::Stmt, std::move(ex));
+  }
+
+  case NodeKind::Push:
+  case NodeKind::Pop:
+  {
+    auto k = (n->kind == NodeKind::Push ? NodeKind::Pop : NodeKind::Push);
+    auto d = n->data;
+
+    std::vector<Node::Ptr> l;
+    for(auto& x : n->lhs)
+      l.emplace_back(invert(x.get()));
+    return make_node(std::move(k), std::move(d), std::move(l));
+  }
+
+  case NodeKind::Unlet:
+  case NodeKind::Let:
+  {
+    // an uncall stores its result just like a call
+    if(is_store(n))
+      return clone(n);
+
+    auto k = (n->kind == NodeKind::Let ? NodeKind::Unlet : NodeKind::Let);
+
+    return make_node(std::move(k), invert(n->lhs[0].get()), invert(n->lhs[1].get()));
+  }
+
+  case NodeKind::If:
+  {
+    std::vector<Node::Ptr> stmts;
+    if(n->lhs.size() < 4)
+    {
+      // without an exit condition, the entry condition must hold afterwards as well
+      stmts.emplace_back(invert(n->lhs[0].get()));
+      for(std::size_t i = 1; i < n->lhs.size(); ++i)
+        stmts.emplace_back(invert(n->lhs[i].get()));
+      return make_node(NodeKind::If, std::move(stmts));
+    }
+    stmts.emplace_back(invert(n->lhs[3].get())); // <- cond2
+    stmts.emplace_back(invert(n->lhs[1].get()));
+    stmts.emplace_back(invert(n->lhs[2].get()));
+    stmts.emplace_back(invert(n->lhs[0].get())); // <- cond1
+
+    return make_node(NodeKind::If, std::move(stmts));
+  }
+
+  case NodeKind::OpEq:
+  {
+    BinOpTypes bin = BinOpTypes::Add;
+
+    switch(std::get<BinOpTypes>(n->data))
+    {
+    case BinOpTypes::Add: bin = BinOpTypes::Sub; break;
+    case BinOpTypes::Sub: bin = BinOpTypes::Add; break;
+    case BinOpTypes::Mul: bin = BinOpTypes::Div; break;
+    case BinOpTypes::Div: bin = BinOpTypes::Mul; break;
+    }
+
+    return make_node(NodeKind::OpEq, std::move(bin), invert(n->lhs[0].get()), invert(n->lhs[1].get()));
+  }
+  }
+  return nullptr;
+}
+
+Node::Ptr invert(const Node* n)
+{
+  auto inv = invert_untyped(n);
+  if(inv)
+    inv->typ = n->typ;
+  return inv;
+}
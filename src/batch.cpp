@@ -0,0 +1,116 @@
+#include <thread_pool.hpp>
+#include <batch.hpp>
+
+#include <filesystem>
+#include <algorithm>
+#include <ostream>
+#include <fstream>
+#include <atomic>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+static std::vector<std::string> collect_inputs(const std::vector<std::string>& paths, std::ostream& err)
+{
+  std::vector<std::string> inputs;
+  for(auto& p : paths)
+  {
+    std::error_code ec;
+    if(!fs::is_directory(p, ec))
+    {
+      inputs.emplace_back(p);
+      continue;
+    }
+    std::vector<std::string> files;
+    for(auto& e : fs::directory_iterator(p, ec))
+      if(e.is_regular_file(ec) && e.path().extension() != ".out")
+        files.emplace_back(e.path().string());
+    if(ec)
+      err << "error: cannot list " << p << "\n";
+    std::sort(files.begin(), files.end());
+    inputs.insert(inputs.end(), files.begin(), files.end());
+  }
+  return inputs;
+}
+
+// Sessions are expensive to set up, so every thread takes an idle one and puts it back.
+class session_pool
+{
+public:
+  session_pool(const std::vector<Fn::Ptr>& fns, const interpreter_options& opts)
+    : fns(fns)
+    , opts(opts)
+  {
+    // the first session builds the inverses, the others only read the functions
+    idle.emplace_back(std::make_unique<session>(fns, opts));
+  }
+
+  std::unique_ptr<session> acquire()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mut);
+      if(!idle.empty())
+      {
+        auto s = std::move(idle.back());
+        idle.pop_back();
+        return s;
+      }
+    }
+    return std::make_unique<session>(fns, opts);
+  }
+
+  void release(std::unique_ptr<session>&& s)
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    idle.emplace_back(std::move(s));
+  }
+
+private:
+  const std::vector<Fn::Ptr>& fns;
+  interpreter_options opts;
+
+  std::mutex mut;
+  std::vector<std::unique_ptr<session>> idle;
+};
+
+std::size_t run_batch(const std::vector<std::string>& paths, const std::vector<Fn::Ptr>& fns,
+                      const interpreter_options& opts, std::ostream& err)
+{
+  auto inputs = collect_inputs(paths, err);
+
+  session_pool sessions(fns, opts);
+  std::atomic<std::size_t> failed { 0 };
+  std::mutex err_mut;
+  thread_pool::global().parallel_for(0, inputs.size(), 1, [&](std::size_t beg, std::size_t end)
+  {
+    auto sess = sessions.acquire();
+    for(std::size_t i = beg; i < end; ++i)
+    {
+      std::ifstream is(inputs[i]);
+      std::ofstream os;
+      if(is)
+        os.open(inputs[i] + ".out");
+
+      std::string problem;
+      try
+      {
+        if(os)
+          sess->run(is, os);
+        if(!os.is_open() || !os)
+          problem = "cannot run";
+      }
+      catch(const std::exception& e)
+      {
+        problem = e.what();
+      }
+      if(!problem.empty())
+      {
+        std::lock_guard<std::mutex> lock(err_mut);
+        err << "error: " << inputs[i] << ": " << problem << "\n";
+        ++failed;
+      }
+    }
+    sessions.release(std::move(sess));
+  });
+  return failed;
+}
@@ -0,0 +1,399 @@
+#include <checkpoint.hpp>
+
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+
+namespace checkpoint
+{
+static constexpr char magic[8] = { 'R', 'A', 'L', 'C', 'H', 'K', 'P', 'T' };
+static constexpr std::uint32_t version = 1;
+
+static volatile std::sig_atomic_t pending = 0;
+
+enum class tag : std::uint8_t
+{
+  unit,
+  num,
+  array,
+  container,
+};
+
+// FNV-1a
+struct hasher
+{
+  void bytes(const void* p, std::size_t n)
+  {
+    auto* b = static_cast<const unsigned char*>(p);
+    for(std::size_t i = 0; i < n; ++i)
+      h = (h ^ b[i]) * 1099511628211ull;
+  }
+
+  template<typename T>
+  void add(const T& v)
+  { bytes(&v, sizeof(T)); }
+
+  void add(const std::string& str)
+  {
+    add(str.size());
+    bytes(str.data(), str.size());
+  }
+
+  void node(const Node* n)
+  {
+    if(!n)
+      return add(std::size_t(0));
+
+    add(n->kind);
+    add(n->data.index());
+    if(auto* num = std::get_if<std::size_t>(&n->data))
+      add(*num);
+    else if(auto* obj = std::get_if<Object>(&n->data))
+      add(obj->name);
+    else if(auto* cmp = std::get_if<CmpTypes>(&n->data))
+      add(*cmp);
+    else if(auto* bin = std::get_if<BinOpTypes>(&n->data))
+      add(*bin);
+    else if(auto* str = std::get_if<std::string>(&n->data))
+      add(*str);
+    add(n->lhs.size());
+    for(auto& x : n->lhs)
+      node(x.get());
+  }
+
+  std::uint64_t h { 14695981039346656037ull };
+};
+
+std::uint64_t fingerprint(const std::vector<std::unique_ptr<Fn>>& fns)
+{
+  // bodies of a compiled module are not loaded yet, its functions are known by their names
+  hasher h;
+  for(auto& f : fns)
+  {
+    h.add(f->name);
+    for(auto& p : f->params)
+      h.add(p.name);
+    h.node(f->body.get());
+  }
+  return h.h;
+}
+
+template<typename T>
+static void put(std::ostream& os, const T& v)
+{ os.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+static void put(std::ostream& os, const std::string& str)
+{
+  put(os, std::uint64_t(str.size()));
+  os.write(str.data(), str.size());
+}
+
+template<typename T>
+static bool get(std::istream& is, T& v)
+{ return bool(is.read(reinterpret_cast<char*>(&v), sizeof(T))); }
+
+static bool get(std::istream& is, std::string& str)
+{
+  std::uint64_t len = 0;
+  if(!get(is, len) || len > (1u << 20))
+    return false;
+  str.resize(len);
+  return bool(is.read(str.data(), len));
+}
+
+namespace
+{
+// Numbers the arrays and containers reachable from the state, each one once.
+struct writer
+{
+  void collect(const value& v)
+  {
+    if(auto* arr = std::get_if<array_value::Ptr>(&v))
+    {
+      if(array_ids.emplace(arr->get(), arrays.size()).second)
+        arrays.push_back(arr->get());
+    }
+    else if(auto* c = std::get_if<container_value::Ptr>(&v))
+    {
+      if(container_ids.emplace(c->get(), containers.size()).second)
+        containers.push_back(c->get());
+    }
+  }
+
+  void collect(const state& s)
+  {
+    for(auto& [name, v] : s.vars)
+      collect(v);
+    for(auto& v : s.stack)
+      collect(v);
+    for(auto& f : s.frames)
+    {
+      for(auto& v : f.args)
+        collect(v);
+      for(auto& sv : f.saved_values)
+        if(sv.val)
+          collect(*sv.val);
+    }
+  }
+
+  void value_of(std::ostream& os, const value& v)
+  {
+    if(auto* num = std::get_if<std::size_t>(&v))
+    {
+      put(os, tag::num);
+      put(os, std::uint64_t(*num));
+    }
+    else if(auto* arr = std::get_if<array_value::Ptr>(&v))
+    {
+      put(os, tag::array);
+      put(os, std::uint64_t(array_ids.at(arr->get())));
+    }
+    else if(auto* c = std::get_if<container_value::Ptr>(&v))
+    {
+      put(os, tag::container);
+      put(os, std::uint64_t(container_ids.at(c->get())));
+    }
+    else
+    {
+      put(os, tag::unit);
+      put(os, std::uint64_t(0));
+    }
+  }
+
+  void values_of(std::ostream& os, const std::vector<value>& vs)
+  {
+    put(os, std::uint64_t(vs.size()));
+    for(auto& v : vs)
+      value_of(os, v);
+  }
+
+  std::unordered_map<const array_value*, std::size_t> array_ids;
+  std::unordered_map<const container_value*, std::size_t> container_ids;
+  std::vector<const array_value*> arrays;
+  std::vector<const container_value*> containers;
+};
+
+struct reader
+{
+  bool value_of(std::istream& is, value& v)
+  {
+    tag t;
+    std::uint64_t x = 0;
+    if(!get(is, t) || !get(is, x))
+      return false;
+    switch(t)
+    {
+    case tag::unit:      v = std::monostate {}; return true;
+    case tag::num:       v = std::size_t(x); return true;
+    case tag::array:     if(x >= arrays.size()) return false; v = arrays[x]; return true;
+    case tag::container: if(x >= containers.size()) return false; v = containers[x]; return true;
+    }
+    return false;
+  }
+
+  bool values_of(std::istream& is, std::vector<value>& vs)
+  {
+    std::uint64_t n = 0;
+    if(!get(is, n))
+      return false;
+    vs.resize(n);
+    return std::all_of(vs.begin(), vs.end(), [&](value& v) { return value_of(is, v); });
+  }
+
+  std::vector<array_value::Ptr> arrays;
+  std::vector<container_value::Ptr> containers;
+};
+}
+
+// Layout, native endian: magic, version, program fingerprint, then the arrays and
+//  containers, the variables, the operand stack and the frames. Values are a tag
+//  and either an integer or the number of an array or container.
+bool write(const std::string& path, const state& s, std::ostream& err)
+{
+  const auto tmp = path + ".tmp";
+  std::ofstream os(tmp, std::ios::binary);
+  if(!os)
+  {
+    err << "error: cannot write checkpoint " << tmp << "\n";
+    return false;
+  }
+  os.write(magic, sizeof(magic));
+  put(os, version);
+  put(os, s.program);
+
+  writer w;
+  w.collect(s);
+  put(os, std::uint64_t(w.arrays.size()));
+  for(auto* arr : w.arrays)
+  {
+    put(os, arr->elem);
+    put(os, std::uint64_t(arr->length));
+    os.write(reinterpret_cast<const char*>(arr->data), arr->bytes());
+  }
+  put(os, std::uint64_t(w.containers.size()));
+  for(auto* c : w.containers)
+  {
+    put(os, c->kind);
+    put(os, c->elem);
+    put(os, std::uint64_t(c->size()));
+    for(std::size_t i = 0; i < c->size(); ++i)
+      put(os, std::uint64_t(c->cell(i)));
+  }
+
+  put(os, std::uint64_t(s.vars.size()));
+  for(auto& [name, v] : s.vars)
+  {
+    put(os, name);
+    w.value_of(os, v);
+  }
+  w.values_of(os, s.stack);
+
+  put(os, std::uint64_t(s.frames.size()));
+  for(auto& f : s.frames)
+  {
+    put(os, f.kind);
+    put(os, std::uint64_t(f.pos));
+    put(os, f.fn);
+    w.values_of(os, f.args);
+    put(os, std::uint64_t(f.saved_values.size()));
+    for(auto& sv : f.saved_values)
+    {
+      put(os, sv.name);
+      put(os, std::uint8_t(sv.val.has_value()));
+      if(sv.val)
+        w.value_of(os, *sv.val);
+      put(os, std::uint64_t(sv.contents.size()));
+      os.write(reinterpret_cast<const char*>(sv.contents.data()), sv.contents.size());
+    }
+  }
+
+  os.close();
+  if(!os || std::rename(tmp.c_str(), path.c_str()) != 0)
+  {
+    err << "error: cannot write checkpoint " << path << "\n";
+    return false;
+  }
+  return true;
+}
+
+std::optional<state> read(const std::string& path, std::ostream& err)
+{
+  std::ifstream is(path, std::ios::binary);
+  if(!is)
+  {
+    err << "error: cannot read checkpoint " << path << "\n";
+    return std::nullopt;
+  }
+  char m[sizeof(magic)];
+  std::uint32_t ver = 0;
+  if(!is.read(m, sizeof(m)) || !std::equal(m, m + sizeof(m), magic) || !get(is, ver))
+  {
+    err << "error: " << path << " is not a ral checkpoint\n";
+    return std::nullopt;
+  }
+  if(ver != version)
+  {
+    err << "error: checkpoint has version " << ver << ", expected " << version << "\n";
+    return std::nullopt;
+  }
+
+  state s;
+  reader r;
+  auto corrupt = [&]()
+  {
+    err << "error: checkpoint " << path << " is truncated or corrupt\n";
+    return std::nullopt;
+  };
+  std::uint64_t n = 0;
+  if(!get(is, s.program) || !get(is, n))
+    return corrupt();
+  for(std::uint64_t i = 0; i < n; ++i)
+  {
+    TypeKind elem;
+    std::uint64_t length = 0;
+    if(!get(is, elem) || !is_int(elem) || !get(is, length))
+      return corrupt();
+    auto arr = std::make_shared<array_value>(elem, length);
+    if(!is.read(reinterpret_cast<char*>(arr->data), arr->bytes()))
+      return corrupt();
+    r.arrays.emplace_back(std::move(arr));
+  }
+  if(!get(is, n))
+    return corrupt();
+  for(std::uint64_t i = 0; i < n; ++i)
+  {
+    TypeKind kind, elem;
+    std::uint64_t size = 0;
+    if(!get(is, kind) || !get(is, elem) || !get(is, size))
+      return corrupt();
+    auto c = std::make_shared<container_value>(kind, elem);
+    for(std::uint64_t k = 0; k < size; ++k)
+    {
+      std::uint64_t cell = 0;
+      if(!get(is, cell))
+        return corrupt();
+      c->push_back(cell);
+    }
+    r.containers.emplace_back(std::move(c));
+  }
+
+  if(!get(is, n))
+    return corrupt();
+  s.vars.resize(n);
+  for(auto& [name, v] : s.vars)
+    if(!get(is, name) || !r.value_of(is, v))
+      return corrupt();
+  if(!r.values_of(is, s.stack) || !get(is, n))
+    return corrupt();
+
+  s.frames.resize(n);
+  for(auto& f : s.frames)
+  {
+    std::uint64_t pos = 0, saved_count = 0;
+    if(!get(is, f.kind) || !get(is, pos) || !get(is, f.fn) || !r.values_of(is, f.args) || !get(is, saved_count))
+      return corrupt();
+    f.pos = pos;
+    f.saved_values.resize(saved_count);
+    for(auto& sv : f.saved_values)
+    {
+      std::uint8_t has = 0;
+      std::uint64_t bytes = 0;
+      if(!get(is, sv.name) || !get(is, has))
+        return corrupt();
+      if(has)
+      {
+        sv.val.emplace();
+        if(!r.value_of(is, *sv.val))
+          return corrupt();
+      }
+      if(!get(is, bytes))
+        return corrupt();
+      sv.contents.resize(bytes);
+      if(!is.read(reinterpret_cast<char*>(sv.contents.data()), bytes))
+        return corrupt();
+    }
+  }
+  return s;
+}
+
+static void on_arrival(int)
+{
+  pending = 1;
+}
+
+void on_signal(int signal)
+{
+  std::signal(signal, on_arrival);
+}
+
+bool requested()
+{
+  if(!pending)
+    return false;
+  pending = 0;
+  return true;
+}
+}
@@ -0,0 +1,92 @@
+#include <container.hpp>
+#include <run_error.hpp>
+
+#include <utility>
+
+static constexpr std::size_t min_capacity = 8;
+
+container_value::container_value(TypeKind kind, TypeKind elem)
+  : kind(kind)
+  , elem(elem)
+{  }
+
+void container_value::reallocate(std::size_t cap)
+{
+  std::unique_ptr<std::size_t[]> fresh(new std::size_t[cap]);
+  for(std::size_t i = 0; i < count; ++i)
+    fresh[i] = at(i);
+
+  cells = std::move(fresh);
+  capacity = cap;
+  head = 0;
+}
+
+void container_value::push_back(std::size_t cell)
+{
+  if(count == capacity)
+    reallocate(capacity == 0 ? min_capacity : 2 * capacity);
+  at(count++) = cell;
+}
+
+void container_value::push_front(std::size_t cell)
+{
+  if(count == capacity)
+    reallocate(capacity == 0 ? min_capacity : 2 * capacity);
+  head = (head + capacity - 1) & (capacity - 1);
+  ++count;
+  at(0) = cell;
+}
+
+std::size_t container_value::pop_back()
+{
+  run_check(count > 0, "Pop from an empty container.");
+  auto cell = at(--count);
+
+  // shrinking at a quarter, not at half, keeps alternating pushes and pops O(1)
+  if(capacity > min_capacity && 4 * count <= capacity)
+    reallocate(capacity / 2);
+  return cell;
+}
+
+std::size_t container_value::pop_front()
+{
+  run_check(count > 0, "Pop from an empty container.");
+  auto cell = at(0);
+  head = (head + 1) & (capacity - 1);
+  --count;
+
+  if(capacity > min_capacity && 4 * count <= capacity)
+    reallocate(capacity / 2);
+  return cell;
+}
+
+std::size_t container_value::back() const
+{
+  run_check(count > 0, "Empty container has no elements.");
+  return at(count - 1);
+}
+
+std::size_t container_value::front() const
+{
+  run_check(count > 0, "Empty container has no elements.");
+  return at(0);
+}
+
+void container_value::swap(container_value& rhs)
+{
+  run_check(kind == rhs.kind && elem == rhs.elem, "Containers must have the same type.");
+  std::swap(cells, rhs.cells);
+  std::swap(capacity, rhs.capacity);
+  std::swap(head, rhs.head);
+  std::swap(count, rhs.count);
+}
+
+bool container_value::operator==(const container_value& rhs) const
+{
+  if(kind != rhs.kind || elem != rhs.elem || count != rhs.count)
+    return false;
+  for(std::size_t i = 0; i < count; ++i)
+    if(at(i) != rhs.at(i))
+      return false;
+  return true;
+}
@@ -0,0 +1,71 @@
+#include <module_loader.hpp>
+#include <embed.hpp>
+
+#include <ostream>
+
+embedded_program::embedded_program(std::vector<std::string> search_path, const interpreter_options& opts)
+  : search_path(std::move(search_path))
+  , opts(opts)
+{  }
+
+embedded_program::~embedded_program() = default;
+
+bool embedded_program::load(const std::string& path, std::ostream& err)
+{
+  if(sess)
+  {
+    err << "error: a program is already loaded\n";
+    return false;
+  }
+  return prepare(module_loader(search_path).load(path, fns, err));
+}
+
+bool embedded_program::load_text(const std::string& text, std::ostream& err)
+{
+  if(sess)
+  {
+    err << "error: a program is already loaded\n";
+    return false;
+  }
+  return prepare(module_loader(search_path).load_text(text, ".", fns, err));
+}
+
+bool embedded_program::prepare(bool loaded)
+{
+  if(!loaded)
+  {
+    fns.clear();
+    return false;
+  }
+  // every function is an entry point of the host, so none is dropped or inlined away
+  sess = std::make_unique<session>(fns, opts);
+  return true;
+}
+
+Fn* embedded_program::find(const std::string& name) const
+{
+  for(auto& f : fns)
+    if(f->name == name)
+      return f.get();
+  return nullptr;
+}
+
+bool embedded_program::call(Fn* f, const host_arg* args, std::size_t n)
+{
+  return sess && sess->call(f, args, n);
+}
+
+bool embedded_program::uncall(Fn* f, const host_arg* args, std::size_t n)
+{
+  return sess && sess->call(f, args, n, true);
+}
+
+bool embedded_program::call_each(Fn* f, const host_arg* args, std::size_t count)
+{
+  return sess && sess->call_each(f, args, count);
+}
+
+bool embedded_program::uncall_each(Fn* f, const host_arg* args, std::size_t count)
+{
+  return sess && sess->call_each(f, args, count, true);
+}
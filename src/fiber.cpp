@@ -0,0 +1,68 @@
+#include <fiber.hpp>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <utility>
+#include <new>
+
+fiber::fiber(Body body, std::size_t stack_bytes)
+  : body(std::move(body))
+  , stack(nullptr)
+  , stack_bytes(stack_bytes)
+{
+  stack = mmap(nullptr, stack_bytes, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if(stack == MAP_FAILED)
+    throw std::bad_alloc();
+
+  // stacks grow down, running past the end hits the guard page instead of other memory
+  mprotect(stack, sysconf(_SC_PAGESIZE), PROT_NONE);
+
+  getcontext(&self);
+  self.uc_stack.ss_sp = stack;
+  self.uc_stack.ss_size = stack_bytes;
+  self.uc_link = &caller;
+
+  // makecontext only passes ints
+  auto p = reinterpret_cast<std::uintptr_t>(this);
+  makecontext(&self, reinterpret_cast<void(*)()>(&fiber::entry), 2,
+              static_cast<std::uint32_t>(std::uint64_t(p) >> 32), static_cast<std::uint32_t>(p));
+}
+
+fiber::~fiber()
+{
+  munmap(stack, stack_bytes);
+}
+
+void fiber::entry(std::uint32_t hi, std::uint32_t lo)
+{
+  auto* f = reinterpret_cast<fiber*>(static_cast<std::uintptr_t>((std::uint64_t(hi) << 32) | lo));
+  // exceptions can't cross a context switch, hand them to `resume`
+  try
+  {
+    f->body(*f);
+  }
+  catch(...)
+  {
+    f->failure = std::current_exception();
+  }
+  f->finished = true;
+  // returning switches to `uc_link`, i.e. back into `resume`
+}
+
+bool fiber::resume()
+{
+  assert(!finished && "Resumed a finished fiber.");
+  swapcontext(&caller, &self);
+
+  if(failure)
+    std::rethrow_exception(std::exchange(failure, nullptr));
+  return finished;
+}
+
+void fiber::suspend()
+{
+  swapcontext(&self, &caller);
+}
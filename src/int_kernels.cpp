@@ -0,0 +1,25 @@
+#include <int_kernels.hpp>
+
+#include <cassert>
+
+static const int_ops int_ops_table[] = {
+  make_int_ops<std::int8_t>(),
+  make_int_ops<std::int16_t>(),
+  make_int_ops<std::int32_t>(),
+  make_int_ops<std::int64_t>(),
+  make_int_ops<std::uint64_t>(),
+};
+
+const int_ops& int_ops_for(TypeKind kind)
+{
+  switch(kind)
+  {
+  case TypeKind::I8:  return int_ops_table[0];
+  case TypeKind::I16: return int_ops_table[1];
+  case TypeKind::I32: return int_ops_table[2];
+  case TypeKind::I64: return int_ops_table[3];
+  default:
+    assert(is_int(kind) && "Expected an integer type.");
+  case TypeKind::U64: return int_ops_table[4];
+  }
+}
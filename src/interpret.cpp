@@ -1,112 +1,181 @@
 #include <interpret.hpp>
+#include <int_kernels.hpp>
+#include <thread_pool.hpp>
+#include <checkpoint.hpp>
+#include <container.hpp>
+#include <run_error.hpp>
+#include <lockstep.hpp>
+#include <analysis.hpp>
+#include <array.hpp>
+#include <trace.hpp>
+#include <memo.hpp>
 #include <ast.hpp>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <unordered_map>
+#include <functional>
 #include <algorithm>
 #include <iostream>
+#include <optional>
+#include <atomic>
+#include <limits>
 #include <cassert>
+#include <mutex>
 #include <map>
+#include <set>
+
+// Closure tier. Functions called often and loops running long are compiled once into
+//  a tree of closures with slots, integer types and operators bound, which run without
+//  the dispatch on the node kind and the operand stack of the interpreter. Whatever
+//  the compiler doesn't handle is run by the interpreter from within the closures.
+// The workers of parallel code share the tier of the interpreter that forked them,
+//  each keeps a copy of what it found so it takes the lock only until then.
+struct Interpreter;
+
+using stmt_code = std::function<void(Interpreter&)>;
+using int_code = std::function<std::size_t(Interpreter&)>;
+
+struct compiled_loop
+{
+  int_code cond1;
+  stmt_code body;
+  int_code cond2;
+};
+
+struct closure_tier
+{
+  struct function
+  {
+    stmt_code body;
+    stmt_code inv_body;
+  };
+
+  std::size_t hot_calls;
+  std::size_t hot_iterations;
+
+  std::mutex mut;
+  std::unordered_map<const Fn*, function> functions;
+  std::unordered_map<const Node*, compiled_loop> loops;
+
+  std::size_t promoted_functions { 0 };
+  std::size_t promoted_loops { 0 };
+  std::size_t compiled_nodes { 0 };
+  std::size_t interpreted_nodes { 0 };
+};
+
+stmt_code compile_stmt(Interpreter& in, const Node* n);
+compiled_loop compile_loop(Interpreter& in, const Node* n);
+
+// Thrown in the forked copy of the process that writes a checkpoint. Every construct
+//  it passes adds a frame, so what arrives at the top is where the run was.
+struct checkpoint_capture {  };
 
 struct Interpreter
 {
-  using DataType = std::variant<std::monostate, std::size_t>;
+  using DataType = std::variant<std::monostate, std::size_t, array_value::Ptr, container_value::Ptr>;
+  static_assert(std::is_same_v<DataType, checkpoint::value>);
 
-  Interpreter(std::ostream& os)
-    : os(os)
+  Interpreter(std::istream& is, std::ostream& os)
+    : is(&is)
+    , os(&os)
     , stack()
     , fns()
-  { stack.reserve(1024 * 1024); }
+  { stack.reserve(256); }
 
-  void register_fn(const Fn* fn)
+  // Interpreter for the iterations of a parallel loop. It sees the same variables,
+  //  arrays are shared by reference, but has its own operand stack.
+  // It counts its own steps from 0, within what is left of the parent's budget, and
+  //  the parent is charged for them with `charge` once the parallel code is done.
+  Interpreter(const Interpreter& parent)
+    : is(parent.is)
+    , os(parent.os)
+    , stack()
+    , vars(parent.vars)
+    , fns(parent.fns)
+    , plans(parent.plans)
+    , lim(parent.lim)
+    , steps_left(parent.lim.counts_steps ? parent.steps_left - (parent.window - parent.until_tick) : 0)
+    , depth(parent.depth)
+    , memory(parent.memory)
+    , tracing(parent.tracing)
+    , tier(parent.tier)
   {
-    fns[fn->name] = fn;
+    stack.reserve(64);
+    until_tick = window = next_window();
   }
 
-  void run(const Node* n)
-  { (*this)(n); }
-
-  Node::Ptr invert(const Node* n)
+  // Values of all variables by slot, the slots of unbound ones are empty.
+  struct variables
   {
-    switch(n->kind)
-    {
-    case NodeKind::Num:
-    case NodeKind::Unit:
-    case NodeKind::Var:
-
-    case NodeKind::Cmp:
-    case NodeKind::Swap:
+    DataType* find(std::uint32_t s)
+    { return s < slots.size() && slots[s] ? &*slots[s] : nullptr; }
 
-    case NodeKind::Uncall:
-    case NodeKind::Call:  // <- TODO! We need an UNCALL
-    {
-      auto k = n->kind == NodeKind::Call   ? NodeKind::Uncall 
-             :(n->kind == NodeKind::Uncall ? NodeKind::Call
-                                           : n->kind);
-      auto d = n->data;
-
-      std::vector<Node::Ptr> l;
-      for(auto& x : n->lhs)
-        l.emplace_back(invert(x.get()));
-      return make_node(std::move(k), std::move(d), std::move(l));
-    }
-    case NodeKind::Loop:
-    case NodeKind::Block:
+    DataType& at(std::uint32_t s)
     {
-      auto k = n->kind;
-      std::vector<Node::Ptr> stmts;
-      for(auto& x : n->lhs)
-        stmts.emplace(stmts.begin(), invert(x.get()));
-      return make_node(std::move(k), std::move(stmts));
+      auto* v = find(s);
+      run_check(v, "Unbound variable!");
+      return *v;
     }
-    case NodeKind::DoYieldUndo:
+
+    void bind(std::uint32_t s, DataType v)
     {
-      assert(false && "Nested do-yield-undo not allowed.");
-      return nullptr;
+      if(s >= slots.size())
+        slots.resize(std::max<std::size_t>(s + 1, slot_count()));
+      run_check(!slots[s], "Variable is already bound.");
+      slots[s] = std::move(v);
+      ++live;
     }
-    case NodeKind::Stmt:
+
+    // binds `s` if it isn't already
+    void set(std::uint32_t s, DataType v)
     {
-      auto ex = invert(n->lhs[0].get());
-      return make_node(NodeKind::Stmt, std::move(ex));
+      if(auto* old = find(s))
+        *old = std::move(v);
+      else
+        bind(s, std::move(v));
     }
 
-    case NodeKind::Unlet:
-    case NodeKind::Let:
+    void unbind(std::uint32_t s)
     {
-      auto k = (n->kind == NodeKind::Let ? NodeKind::Unlet : NodeKind::Let);
-
-      return make_node(std::move(k), invert(n->lhs[0].get()), invert(n->lhs[1].get()));
+      run_check(find(s), "Unbound variable!");
+      slots[s].reset();
+      --live;
     }
 
-    case NodeKind::If:
-    {
-      std::vector<Node::Ptr> stmts;
-      stmts.emplace_back(invert(n->lhs[3].get())); // <- cond2
-      stmts.emplace_back(invert(n->lhs[1].get()));
-      stmts.emplace_back(invert(n->lhs[2].get()));
-      stmts.emplace_back(invert(n->lhs[0].get())); // <- cond1
+    std::size_t size() const
+    { return live; }
 
-      return make_node(NodeKind::If, std::move(stmts));
-    }
+    bool empty() const
+    { return live == 0; }
 
-    case NodeKind::OpEq:
+    void clear()
     {
-      BinOpTypes bin = BinOpTypes::Add;
+      slots.clear();
+      live = 0;
+    }
 
-      switch(std::get<BinOpTypes>(n->data))
-      {
-      case BinOpTypes::Add: bin = BinOpTypes::Sub; break;
-      case BinOpTypes::Sub: bin = BinOpTypes::Add; break;
-      case BinOpTypes::Mul: bin = BinOpTypes::Div; break;
-      case BinOpTypes::Div: bin = BinOpTypes::Mul; break;
-      }
+    std::vector<std::optional<DataType>> slots;
+    std::size_t live { 0 };
+  };
 
-      return make_node(NodeKind::OpEq, std::move(bin), invert(n->lhs[0].get()), invert(n->lhs[1].get()));
-    }
-    }
-    return nullptr;
+  void register_fn(Fn* fn)
+  {
+    fns[fn->name] = fn;
   }
 
+  void run(const Node* n)
+  { (*this)(n); }
+
   void operator()(const Node* n)
   {
+    // one decrement per node, the clock and step budget are only looked at every so often
+    if(--until_tick == 0)
+      tick();
+    if(stack.size() > lim.max_stack)
+      throw limit_exceeded("operand stack exceeds " + std::to_string(lim.max_stack * sizeof(DataType)) + " bytes");
+
     switch(n->kind)
     {
     case NodeKind::Unit:
@@ -121,31 +190,46 @@ struct Interpreter
     }
     case NodeKind::Var:
     {
-      auto name = std::get<Object>(n->data).name;
-      auto pos = vars.find(name);
-      assert(pos != vars.end() && "Unbound variable!");
-
-      stack.emplace_back(pos->second);
+      stack.emplace_back(vars.at(std::get<Object>(n->data).slot));
+      return;
+    }
+    case NodeKind::Index:
+    {
+      auto& arr = array_of(n);
+      stack.emplace_back(arr.load(index_of(n)));
       return;
     }
     case NodeKind::OpEq:
     {
-      auto id = std::get<Object>(n->lhs[0]->data).name;
-      auto var = std::get<std::size_t>(vars[id]);
-
-      run(n->lhs[1].get());
-      auto rhs_v = stack.back(); stack.pop_back();
-      auto rhs = std::get<std::size_t>(rhs_v);
+      auto op = std::get<BinOpTypes>(n->data);
+      if(is_array(n->typ))
+      {
+        // element-wise, either with another array or broadcasting a scalar
+        auto& arr = array_of(n->lhs[0].get());
 
-      switch(std::get<BinOpTypes>(n->data))
+        run(n->lhs[1].get());
+        auto rhs_v = stack.back(); stack.pop_back();
+        if(auto rhs = std::get_if<array_value::Ptr>(&rhs_v))
+          arr.update(op, **rhs);
+        else
+          arr.update(op, std::get<std::size_t>(rhs_v));
+        return;
+      }
+      if(n->lhs[0]->kind == NodeKind::Index)
       {
-      case BinOpTypes::Add: var += rhs; break;
-      case BinOpTypes::Sub: var -= rhs; break;
-      case BinOpTypes::Mul: var *= rhs; break;
-      case BinOpTypes::Div: var /= rhs; break;
+        auto& arr = array_of(n->lhs[0].get());
+        auto idx = index_of(n->lhs[0].get());
+        auto rhs = integer(n->lhs[1].get());
+
+        arr.store(idx, ops_of(n, n->typ).binop(op, arr.load(idx), rhs));
+        return;
       }
+      auto id = std::get<Object>(n->lhs[0]->data).slot;
+      auto var = std::get<std::size_t>(vars.at(id));
+      auto rhs = integer(n->lhs[1].get());
+
       // put it back into the variant
-      vars[id] = var;
+      vars.at(id) = ops_of(n, n->typ).binop(op, var, rhs);
       return;
     }
     case NodeKind::Cmp:
@@ -156,55 +240,170 @@ struct Interpreter
       auto a = stack.back(); stack.pop_back();
       auto b = stack.back(); stack.pop_back();
 
-      switch(std::get<CmpTypes>(n->data))
+      auto op = std::get<CmpTypes>(n->data);
+      if(std::holds_alternative<std::size_t>(a) && std::holds_alternative<std::size_t>(b))
       {
-      case CmpTypes::Equal:        stack.emplace_back(a == b); break;
-      case CmpTypes::InEqual:      stack.emplace_back(a != b); break;
-      case CmpTypes::Less:         stack.emplace_back(a < b); break;
-      case CmpTypes::LessEqual:    stack.emplace_back(a <= b); break;
-      case CmpTypes::GreaterEqual: stack.emplace_back(a >= b); break;
-      case CmpTypes::Greater:      stack.emplace_back(a > b); break;
+        auto& ops = ops_of(n, n->lhs[0]->typ);
+        stack.emplace_back(std::size_t(ops.cmp(op, std::get<std::size_t>(a), std::get<std::size_t>(b))));
+        return;
+      }
+      switch(op)
+      {
+      case CmpTypes::Equal:        stack.emplace_back(std::size_t(a == b)); break;
+      case CmpTypes::InEqual:      stack.emplace_back(std::size_t(a != b)); break;
+      case CmpTypes::Less:         stack.emplace_back(std::size_t(a < b)); break;
+      case CmpTypes::LessEqual:    stack.emplace_back(std::size_t(a <= b)); break;
+      case CmpTypes::GreaterEqual: stack.emplace_back(std::size_t(a >= b)); break;
+      case CmpTypes::Greater:      stack.emplace_back(std::size_t(a > b)); break;
       }
       return;
     }
+    case NodeKind::Arith:
+    {
+      stack.emplace_back(arith(n));
+      return;
+    }
     case NodeKind::Let:
     {
-      auto obj = std::get<Object>(n->lhs[0]->data);
-      auto it = vars.find(obj.name);
-
-      assert(it == vars.end());
+      auto slot = std::get<Object>(n->lhs[0]->data).slot;
 
       run(n->lhs[1].get());
-      auto val = stack.back(); stack.pop_back();
-      vars.emplace(obj.name, val);
+      auto val = normalize(n->typ, stack.back()); stack.pop_back();
+      if(is_array(n->typ))
+      {
+        charge_memory(array_bytes(Type::Array::elem(n->typ)->kind, Type::Array::length(n->typ)));
+        val = make_array(n->typ, val);
+      }
+      else if(is_container(n->typ))
+      {
+        run_check(std::holds_alternative<std::monostate>(val), "Stacks and queues start out empty, with `()`.");
+        val = std::make_shared<container_value>(n->typ->kind, Type::Container::elem(n->typ)->kind);
+      }
+      if(tracing)
+        trace::record(trace::event_kind::let, slot, traced(val), steps());
+      if(is_store(n))
+        vars.set(slot, std::move(val));
+      else
+        vars.bind(slot, std::move(val));
+      check_vars();
       return;
     }
     case NodeKind::Unlet:
     {
-      auto obj = std::get<Object>(n->lhs[0]->data);
-      auto it = vars.find(obj.name);
-
-      assert(it != vars.end());
+      auto slot = std::get<Object>(n->lhs[0]->data).slot;
 
       run(n->lhs[1].get());
-      auto val = stack.back(); stack.pop_back();
+      auto val = normalize(n->typ, stack.back()); stack.pop_back();
 
-      assert(it->second == val);
-      vars.erase(it);
+      auto& cur = vars.at(slot);
+      if(auto arr = std::get_if<array_value::Ptr>(&cur))
+      {
+        if(auto rhs = std::get_if<array_value::Ptr>(&val))
+          run_check(**arr == **rhs, "Unlet of an array with other contents.");
+        else
+          run_check((*arr)->all_equal(std::get<std::size_t>(val)), "Unlet of an array with other contents.");
+      }
+      else if(auto c = std::get_if<container_value::Ptr>(&cur))
+      {
+        if(auto rhs = std::get_if<container_value::Ptr>(&val))
+          run_check(**c == **rhs, "Unlet of a stack or queue with other contents.");
+        else
+          run_check((*c)->empty(), "Stacks and queues must be empty when they are unlet.");
+      }
+      else
+        run_check(cur == val, "Unlet of a variable with another value.");
+      if(tracing)
+        trace::record(trace::event_kind::unlet, slot, traced(cur), steps());
+      release_memory(memory_of(cur));
+      vars.unbind(slot);
       return;
     }
     case NodeKind::Block:
     {
-      for(auto& v : n->lhs)
-        run(v.get());
+      auto* plan = block_plan_of(n);
+      if(plan && plan->parallel && !resuming)
+      {
+        run_stages(n, *plan);
+        return;
+      }
+      std::size_t i = (resuming ? resume_frame(NodeKind::Block).pos : 0);
+      try
+      {
+        for(; i < n->lhs.size(); ++i)
+        {
+          if(checkpoint_due)
+            checkpoint();
+          run(n->lhs[i].get());
+        }
+      }
+      catch(const checkpoint_capture&)
+      {
+        capture(NodeKind::Block, i);
+        throw;
+      }
       return;
     }
     case NodeKind::Swap:
     {
-      auto lhs = std::get<Object>(n->lhs[0]->data).name;
-      auto rhs = std::get<Object>(n->lhs[1]->data).name;
+      auto l = n->lhs[0].get();
+      auto r = n->lhs[1].get();
+      if(l->kind == NodeKind::Index || r->kind == NodeKind::Index)
+      {
+        // evaluate both places before touching either of them
+        auto lidx = (l->kind == NodeKind::Index ? index_of(l) : 0);
+        auto ridx = (r->kind == NodeKind::Index ? index_of(r) : 0);
+        auto a = load(l, lidx);
+        auto b = load(r, ridx);
+        store(l, lidx, b);
+        store(r, ridx, a);
+        return;
+      }
+      auto& a = vars.at(std::get<Object>(l->data).slot);
+      auto& b = vars.at(std::get<Object>(r->data).slot);
+      if(std::holds_alternative<array_value::Ptr>(a) && std::holds_alternative<array_value::Ptr>(b))
+        std::get<array_value::Ptr>(a)->swap(*std::get<array_value::Ptr>(b));
+      else if(std::holds_alternative<container_value::Ptr>(a) && std::holds_alternative<container_value::Ptr>(b))
+        std::get<container_value::Ptr>(a)->swap(*std::get<container_value::Ptr>(b));
+      else
+        std::swap(a, b);
+      return;
+    }
+    case NodeKind::Push:
+    case NodeKind::Pop:
+    {
+      auto x = n->lhs[0].get();
+      auto& c = container_of(n->lhs[1].get());
+      const auto idx = (x->kind == NodeKind::Index ? index_of(x) : 0);
 
-      std::swap(vars[lhs], vars[rhs]);
+      // a stack pushes and pops at the back, a queue pops and unpushes at the front
+      const bool front = (std::get<std::size_t>(n->data) != 0 && c.kind == TypeKind::Queue);
+      if(n->kind == NodeKind::Push)
+      {
+        auto cell = load(x, idx);
+        charge_memory(sizeof(std::size_t));
+        if(front)
+          c.push_front(cell);
+        else
+          c.push_back(cell);
+        store(x, idx, 0);
+      }
+      else
+      {
+        run_check(load(x, idx) == 0, "Can only pop into a zero.");
+        store(x, idx, front ? c.pop_front() : c.pop_back());
+        release_memory(sizeof(std::size_t));
+      }
+      return;
+    }
+    case NodeKind::Size:
+    {
+      stack.emplace_back(DataType { container_of(n->lhs[0].get()).size() });
+      return;
+    }
+    case NodeKind::Top:
+    {
+      auto& c = container_of(n->lhs[0].get());
+      stack.emplace_back(DataType { c.kind == TypeKind::Queue ? c.front() : c.back() });
       return;
     }
     case NodeKind::Stmt:
@@ -214,154 +413,1569 @@ struct Interpreter
     }
     case NodeKind::DoYieldUndo:
     {
-      // run the do block
-      run(n->lhs[0].get());
-      // run the yield
-      run(n->lhs[1].get());
-
-      auto inv = invert(n->lhs[0].get());
-      run(inv.get());
+      do_yield_undo(n);
       return;
     }
     case NodeKind::If:
     {
-      run(n->lhs[0].get());
-      auto cond_v = stack.back(); stack.pop_back();
-      auto cond = std::get<std::size_t>(cond_v);
-
-      if(cond != 0)
-        run(n->lhs[1].get());
+      std::size_t branch = 0;
+      if(resuming)
+        branch = resume_frame(NodeKind::If).pos;
       else
-        run(n->lhs[2].get());
+      {
+        run(n->lhs[0].get());
+        auto cond_v = stack.back(); stack.pop_back();
+        branch = (std::get<std::size_t>(cond_v) != 0 ? 1 : 2);
+      }
+
+      if(branch == 2 && n->lhs.size() <= 2)
+        return;
+      try
+      {
+        run(n->lhs[branch].get());
+      }
+      catch(const checkpoint_capture&)
+      {
+        capture(NodeKind::If, branch);
+        throw;
+      }
+
+      // the inverse picks its branch by the exit condition, the entry one if there is none
+      run(n->lhs[n->lhs.size() > 3 ? 3 : 0].get());
+      auto exit_v = stack.back(); stack.pop_back();
+      run_check((std::get<std::size_t>(exit_v) != 0) == (branch == 1), "The exit condition of an if does not match the branch taken.");
       return;
     }
     case NodeKind::Loop:
     {
-      run(n->lhs[0].get());
-      auto cond1_v = stack.back(); stack.pop_back();
-      auto cond1 = std::get<std::size_t>(cond1_v);
+      if(tier && !resuming)
+        if(auto* code = compiled_loop_of(n))
+        {
+          run_loop(*code, true, 0);
+          return;
+        }
 
-      if(cond1 != 0)
+      if(resuming)
+        resume_frame(NodeKind::Loop);
+      else
+      {
+        run(n->lhs[0].get());
+        auto cond1_v = stack.back(); stack.pop_back();
+        if(std::get<std::size_t>(cond1_v) == 0)
+          return;
+      }
+
+      DataType cond2 = std::size_t(0);
+      std::uint64_t iteration = 0;
+      do
       {
-        DataType cond2 = std::size_t(0);
-        do
+        if(tracing)
+          trace::record(trace::event_kind::iteration, 0, iteration, steps());
+        ++iteration;
+
+        // eval statement
+        try
         {
-          // eval statement
+          if(checkpoint_due)
+            checkpoint();
           run(n->lhs[1].get());
+        }
+        catch(const checkpoint_capture&)
+        {
+          capture(NodeKind::Loop);
+          throw;
+        }
 
-          // eval condition
-          run(n->lhs[2].get());
-          cond2 = stack.back(); stack.pop_back();
-        } while(std::get<std::size_t>(cond2) == 0);
+        // eval condition
+        run(n->lhs[2].get());
+        cond2 = stack.back(); stack.pop_back();
+
+        // a hot loop goes on compiled, next time it starts out compiled
+        if(tier && iteration == tier->hot_iterations && std::get<std::size_t>(cond2) == 0)
+        {
+          run_loop(promote_loop(n), false, iteration);
+          return;
+        }
+      } while(std::get<std::size_t>(cond2) == 0);
+      return;
+    }
+    case NodeKind::ParFor:
+    {
+      auto idx = std::get<Object>(n->lhs[0]->data).slot;
+      run(n->lhs[1].get());
+      run(n->lhs[2].get());
+      auto end = std::get<std::size_t>(stack.back()); stack.pop_back();
+      auto beg = std::get<std::size_t>(stack.back()); stack.pop_back();
+      if(beg >= end)
+        return;
+
+      // iterations run in any order, there is no single place to resume them from
+      scoped_count no_checkpoint(no_checkpoints);
+      auto body = n->lhs[3].get();
+      auto& pool = thread_pool::global();
+      if(pool.size() == 1 || end - beg == 1)
+      {
+        iterate(idx, body, beg, end);
+        return;
       }
+      // a few chunks per thread so that stealing can balance uneven iterations
+      const std::size_t grain = std::max<std::size_t>(1, (end - beg) / (pool.size() * 8));
+      std::atomic<std::size_t> done { 0 };
+      pool.parallel_for(beg, end, grain, [this, &idx, body, &done](std::size_t b, std::size_t e)
+      {
+        Interpreter worker(*this);
+        worker.iterate(idx, body, b, e);
+        done += worker.steps();
+      });
+      charge(done);
       return;
     }
     case NodeKind::Call:
+    case NodeKind::Uncall:
     {
-      auto store = std::get<Object>(n->lhs[0]->data).name;
-      auto fn_name = std::get<Object>(n->lhs[1]->data).name;
+      auto store = std::get<Object>(n->lhs[0]->data).slot;
+      auto& fn_name = std::get<Object>(n->lhs[1]->data).name;
+      const bool uncall = (n->kind == NodeKind::Uncall);
 
       auto it = fns.find(fn_name);
       if(it != fns.end())
       {
         auto fn = it->second;
-        assert(fn->params.size() == n->lhs.size() - 2 && "function call arguments must match");
+        run_check(fn->params.size() == n->lhs.size() - 2, "function call arguments must match");
 
-        // set parameter values
-        std::vector<std::size_t> args;
-        args.reserve(fn->params.size());
-        for(std::size_t i = 0; i < fn->params.size(); ++i)
+        // set parameter values, arrays are passed by reference
+        std::vector<DataType> args;
+        const bool resumed = resuming;
+        if(resumed)
+          args = resume_path[resume_at].args;
+        else
         {
-          run(n->lhs[i + 2].get());
+          args.reserve(fn->params.size());
+          for(std::size_t i = 0; i < fn->params.size(); ++i)
+          {
+            run(n->lhs[i + 2].get());
 
-          args.emplace_back(std::get<std::size_t>(stack.back())); stack.pop_back();
+            args.emplace_back(normalize(fn->params[i].type, stack.back())); stack.pop_back();
+          }
         }
-        call(fn, std::move(args));
 
-        // TODO: Fix this! We may want to return an int or anything like that as well
-        vars[store] = std::monostate{};
+        invoke(fn, std::get<Object>(n->lhs[1]->data).slot, store, std::move(args), uncall, resumed);
         return;
       }
+      run_check(!uncall, "Builtins cannot be uncalled.");
 
       if(fn_name == "print")
       {
         run(n->lhs[2].get());
         auto v_v = stack.back(); stack.pop_back();
 
-        std::cout << std::get<std::size_t>(v_v) << "\n";
+        int_ops_for(n->lhs[2]->typ).print(*os, std::get<std::size_t>(v_v));
+        *os << "\n";
 
-        vars[store] = std::monostate {};
+        vars.set(store, std::monostate {});
       }
       else if(fn_name == "read")
       {
         std::size_t tmp = 0;
-        std::cin >> tmp;
+        *is >> tmp;
 
-        vars[store] = tmp;
+        vars.set(store, tmp);
       }
       else
-        assert(false);
+        fail_run("Call of an unknown function.");
       return;
     }
     }
   }
 
-  void call(const Fn* foo, std::vector<std::size_t>&& args)
+  // Calls `fn` with evaluated arguments and sets `store`. `fn_slot` is the slot of its name.
+  void invoke(Fn* fn, std::uint32_t fn_slot, std::uint32_t store, std::vector<DataType>&& args, bool uncall, bool resumed = false)
   {
-    assert(foo && foo->params.size() == args.size());
+    if(tracing)
+      trace::record(uncall ? trace::event_kind::uncall : trace::event_kind::call, fn_slot, depth, steps());
 
-    // TODO: Consider export/import
-    //TODO: only let/unlet non-mut args
-    // Let the arguments
-    for(std::size_t i = 0; i < foo->params.size(); ++i)
+    auto memo = memos.find(fn);
+    if(memo == memos.end() || resumed)
+      call(fn, std::move(args), uncall);
+    else
     {
-      auto& p = foo->params[i];
+      memo_table::Key key;
+      key.reserve(args.size());
+      for(auto& a : args)
+        key.emplace_back(std::get<std::size_t>(a));
+
+      if(!memo->second.lookup(key, uncall))
+      {
+        call(fn, std::move(args), uncall);
+        memo->second.insert(std::move(key), uncall);
+      }
+    }
+    if(tracing)
+      trace::record(uncall ? trace::event_kind::uncall_exit : trace::event_kind::call_exit, fn_slot, depth, steps());
+
+    // TODO: Fix this! We may want to return an int or anything like that as well
+    vars.set(store, std::monostate {});
+  }
+
+  // estimated steps for which a group of statements is worth a thread
+  static constexpr std::size_t parallel_block_cost = 256;
+
+  struct plan_cache
+  {
+    std::set<std::string> pure;
+
+    std::mutex mut;
+    std::unordered_map<const Node*, block_plan> plans;
+  };
+
+  const block_plan* block_plan_of(const Node* n)
+  {
+    if(!plans || thread_pool::global().size() == 1)
+      return nullptr;
+
+    auto it = local_plans.find(n);
+    if(it != local_plans.end())
+      return it->second;
+
+    std::lock_guard<std::mutex> lock(plans->mut);
+    auto pos = plans->plans.find(n);
+    if(pos == plans->plans.end())
+      pos = plans->plans.emplace(n, plan_block(n, plans->pure, fns, parallel_block_cost)).first;
+    return local_plans.emplace(n, &pos->second).first->second;
+  }
+
+  // Cheap groups run right here, the others each on a copy of this interpreter. Since
+  //  no group touches what another one writes, taking over the variables each group
+  //  wrote gives the same state as running the statements in order.
+  void run_stages(const Node* n, const block_plan& plan)
+  {
+    scoped_count no_checkpoint(no_checkpoints);
+    for(auto& st : plan.stages)
+    {
+      std::vector<const block_plan::group*> heavy;
+      for(auto& g : st)
+      {
+        if(g.cost >= parallel_block_cost)
+          heavy.push_back(&g);
+        else
+          for(auto i : g.stmts)
+            run(n->lhs[i].get());
+      }
+      if(heavy.size() < 2)
+      {
+        for(auto* g : heavy)
+          for(auto i : g->stmts)
+            run(n->lhs[i].get());
+        continue;
+      }
 
-      auto it = vars.find(p.name);
-      assert(it == vars.end());
+      std::vector<std::unique_ptr<Interpreter>> workers;
+      for(std::size_t k = 0; k < heavy.size(); ++k)
+        workers.emplace_back(std::make_unique<Interpreter>(*this));
+      const auto memory_before = memory;
+      thread_pool::global().parallel_for(0, heavy.size(), 1, [&](std::size_t b, std::size_t e)
+      {
+        for(std::size_t k = b; k < e; ++k)
+          for(auto i : heavy[k]->stmts)
+            workers[k]->run(n->lhs[i].get());
+      });
+      // each group had what was left, together they may still have taken too much
+      for(auto& w : workers)
+      {
+        charge(w->steps());
+        if(w->memory > memory_before)
+          charge_memory(w->memory - memory_before);
+        else
+          release_memory(memory_before - w->memory);
+      }
 
-      vars.emplace(p.name, args[i]);
+      for(std::size_t k = 0; k < heavy.size(); ++k)
+        for(auto& name : heavy[k]->writes)
+        {
+          auto slot = slot_of(name);
+          if(auto* v = workers[k]->vars.find(slot))
+            vars.set(slot, std::move(*v));
+          else if(vars.find(slot))
+            vars.unbind(slot);
+        }
     }
-    // Run function body
-    run(foo->body.get());
-    // Unlet the arguments
-    for(std::size_t i = 0; i < foo->params.size(); ++i)
+  }
+
+  struct limits
+  {
+    std::size_t max_stack { std::numeric_limits<std::size_t>::max() };
+    std::size_t max_depth { std::numeric_limits<std::size_t>::max() };
+    std::size_t max_vars { std::numeric_limits<std::size_t>::max() };
+    std::size_t max_memory { std::numeric_limits<std::size_t>::max() };
+    bool counts_steps { false };
+    bool has_deadline { false };
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  static constexpr std::size_t tick_interval = 1 << 16;
+
+  void set_limits(const interpreter_options& opts)
+  {
+    auto or_max = [](std::size_t v) { return v == 0 ? std::numeric_limits<std::size_t>::max() : v; };
+    lim.max_stack = or_max(opts.max_stack_bytes / sizeof(DataType));
+    lim.max_depth = or_max(opts.max_call_depth);
+    lim.max_vars = or_max(opts.max_vars);
+    lim.max_memory = or_max(opts.max_memory);
+    lim.counts_steps = opts.max_steps != 0;
+    lim.has_deadline = opts.timeout.count() != 0;
+    lim.deadline = std::chrono::steady_clock::now() + opts.timeout;
+
+    steps_left = opts.max_steps;
+    tracing = trace::enabled();
+    checkpoints = !opts.checkpoint_path.empty();
+    checkpoint_every = opts.checkpoint_every;
+    next_checkpoint = std::chrono::steady_clock::now() + checkpoint_every;
+    checkpoint_wanted = checkpoint_due = resuming = false;
+    no_checkpoints = 0;
+    captured.clear();
+    resume_path.clear();
+    depth = 0;
+    memory = 0;
+    executed = 0;
+    until_tick = window = next_window();
+  }
+
+  // nodes evaluated so far in this run
+  std::size_t steps() const
+  { return executed + (window - until_tick); }
+
+  // what a trace shows of a value: integers themselves, arrays and containers their size
+  static std::uint64_t traced(const DataType& v)
+  {
+    if(auto* i = std::get_if<std::size_t>(&v))
+      return *i;
+    if(auto* arr = std::get_if<array_value::Ptr>(&v))
+      return (*arr)->length;
+    if(auto* c = std::get_if<container_value::Ptr>(&v))
+      return (*c)->size();
+    return 0;
+  }
+
+  void trace_do(trace::event_kind kind, std::uint64_t restore)
+  {
+    if(tracing)
+      trace::record(kind, 0, restore, steps());
+  }
+
+  std::size_t next_window() const
+  {
+    auto w = tick_interval;
+    if(lim.counts_steps)
+      w = std::min(w, steps_left);
+    if(refuel)
+      w = std::min(w, fuel_left);
+    return w;
+  }
+
+  // runs after every `window` steps
+  void tick()
+  {
+    if(tracing)
+      trace::poll();
+    if(checkpoints)
     {
-      auto& p = foo->params[i];
+      checkpoint_wanted = checkpoint_wanted || checkpoint::requested()
+                       || (checkpoint_every.count() != 0 && std::chrono::steady_clock::now() >= next_checkpoint);
+      checkpoint_due = checkpoint_wanted;
+    }
+
+    const auto used = window;
+    executed += used;
+    window = 0;
+    if(lim.counts_steps)
+    {
+      steps_left -= used;
+      if(steps_left == 0)
+        throw limit_exceeded("step limit reached");
+    }
+    if(lim.has_deadline && std::chrono::steady_clock::now() > lim.deadline)
+      throw limit_exceeded("time limit reached");
+    if(refuel)
+    {
+      fuel_left -= used;
+      if(fuel_left == 0)
+        fuel_left = std::max<std::size_t>(refuel(), 1);
+    }
+    until_tick = window = next_window();
+  }
 
-      auto it = vars.find(p.name);
-      assert(it != vars.end());
+  // Runs at the start of a statement once a checkpoint is due. This process goes on
+  //  right away, a forked copy of it unwinds to collect the frames and writes them.
+  // If that isn't possible here, or the last checkpoint is still being written,
+  //  the next tick asks again.
+  // The copy only has this thread. If there are others, e.g. of the thread pool, they
+  //  may hold locks the copy would wait for forever, so then no checkpoint is taken.
+  void checkpoint()
+  {
+    checkpoint_due = false;
+    if(no_checkpoints > 0)
+      return;
+    if(thread_pool::spawned_threads())
+    {
+      std::cerr << "warning: no checkpoints while other threads run\n";
+      checkpoints = checkpoint_wanted = false;
+      return;
+    }
+    if(writer != 0)
+    {
+      if(waitpid(writer, nullptr, WNOHANG) == 0)
+        return;
+      writer = 0;
+    }
+    checkpoint_wanted = false;
+    next_checkpoint = std::chrono::steady_clock::now() + checkpoint_every;
 
-      assert(std::get<std::size_t>(it->second) == args[i]);
-      vars.erase(it);
+    // a resumed run starts printing where this one was
+    os->flush();
+    writer = fork();
+    if(writer < 0)
+    {
+      std::cerr << "error: cannot fork to write a checkpoint\n";
+      writer = 0;
     }
+    else if(writer == 0)
+      throw checkpoint_capture {};
   }
 
-  std::ostream& os;
-  std::vector<DataType> stack;
-  std::map<std::string, DataType> vars;
-  std::map<std::string, const Fn*> fns;
-};
+  checkpoint::frame& capture(NodeKind kind, std::size_t pos = 0)
+  {
+    auto& f = captured.emplace_back();
+    f.kind = kind;
+    f.pos = pos;
+    return f;
+  }
 
-void interpret(std::ostream& os, const std::vector<Fn::Ptr>& nods)
-{
-  Interpreter interp(os);
+  void wait_for_checkpoint()
+  {
+    if(writer != 0)
+      waitpid(writer, nullptr, 0);
+    writer = 0;
+  }
 
-  for(auto& x : nods)
-    interp.register_fn(x.get());
+  checkpoint::state snapshot() const
+  {
+    checkpoint::state s;
+    for(std::uint32_t slot = 0; slot < vars.slots.size(); ++slot)
+      if(vars.slots[slot])
+        s.vars.emplace_back(slot_name(slot), *vars.slots[slot]);
+    s.stack = stack;
+    s.frames.assign(captured.rbegin(), captured.rend());
+    return s;
+  }
 
-  Fn* main = nullptr;
-  for(auto& x : nods)
-    if(x->name == "main")
-      main = x.get();
-  assert(main && "No entry point");
-  // TODO: check main for correct return type
+  void resume_from(checkpoint::state&& s)
+  {
+    for(auto& [name, v] : s.vars)
+    {
+      charge_memory(memory_of(v));
+      vars.bind(slot_of(name), std::move(v));
+    }
+    stack = std::move(s.stack);
+    resume_path = std::move(s.frames);
+    resume_at = 0;
+    resuming = !resume_path.empty();
+  }
 
-  // TODO: check for argc/argv with correct types
-  assert(main->params.size() == 1 && "Entry point must have exactly one argument.");
+  // The frame of the construct being resumed, the run goes on as usual once the
+  //  innermost one is taken.
+  checkpoint::frame resume_frame(NodeKind kind)
+  {
+    run_check(resume_at < resume_path.size() && resume_path[resume_at].kind == kind, "Checkpoint doesn't fit the program.");
+    auto f = std::move(resume_path[resume_at]);
+    if(++resume_at == resume_path.size())
+    {
+      resuming = false;
+      resume_path.clear();
+    }
+    return f;
+  }
 
-  interp.call(main, { 0 });
+  struct scoped_count
+  {
+    std::size_t& count;
+    scoped_count(std::size_t& count) : count(count) { ++count; }
+    ~scoped_count() { --count; }
+  };
 
-  assert(interp.vars.empty() && "all lets must be cleaned up with an unlet");
-}
+  void check_vars() const
+  {
+    if(vars.size() > lim.max_vars)
+      throw limit_exceeded("more than " + std::to_string(lim.max_vars) + " live variables");
+  }
 
+  // Arrays, stacks and queues of the run take `bytes` more, checked before allocating.
+  void charge_memory(std::size_t bytes)
+  {
+    if(bytes > lim.max_memory - memory)
+      throw limit_exceeded("arrays, stacks and queues exceed " + std::to_string(lim.max_memory) + " bytes");
+    memory += bytes;
+  }
+
+  // arrays of the host were never charged, so don't go below 0 for them
+  void release_memory(std::size_t bytes)
+  { memory -= std::min(bytes, memory); }
+
+  static std::size_t memory_of(const DataType& v)
+  {
+    if(auto* arr = std::get_if<array_value::Ptr>(&v))
+      return (*arr)->bytes();
+    if(auto* c = std::get_if<container_value::Ptr>(&v))
+      return (*c)->size() * sizeof(std::size_t);
+    return 0;
+  }
+
+  struct undo_step
+  {
+    undo_plan plan;
+    Node::Ptr inverse;
+    std::vector<std::uint32_t> slots;
+  };
+
+  undo_step& undo_step_of(const Node* n)
+  {
+    auto it = undo_steps.find(n);
+    if(it != undo_steps.end())
+      return it->second;
+
+    undo_step step { plan_undo(n), nullptr, {} };
+    if(!step.plan.restore)
+      step.inverse = invert(n->lhs[0].get());
+    for(auto& name : step.plan.writes)
+      step.slots.push_back(slot_of(name));
+    return undo_steps.emplace(n, std::move(step)).first->second;
+  }
+
+  // `do S₁ yield S₂ undo`, resumed at `phase` with the values to put back
+  void do_yield_undo(const Node* n)
+  {
+    auto& step = undo_step_of(n);
+
+    // If the yield doesn't touch what the do block writes, undo by putting it back.
+    // There is no inverse to run then.
+    std::size_t phase = 0;
+    std::vector<saved_value> saved;
+    if(resuming)
+    {
+      auto f = resume_frame(NodeKind::DoYieldUndo);
+      phase = f.pos;
+      for(auto& s : f.saved_values)
+        saved.push_back({ slot_of(s.name), std::move(s.val), std::move(s.contents) });
+    }
+    else if(step.plan.restore)
+    {
+      saved.reserve(step.plan.writes.size());
+      for(auto slot : step.slots)
+        saved.emplace_back(save(slot));
+    }
+
+    static constexpr trace::event_kind marks[] = { trace::event_kind::do_begin, trace::event_kind::yield, trace::event_kind::undo };
+    const Node* phases[] = { n->lhs[0].get(), n->lhs[1].get(), step.inverse.get() };
+    try
+    {
+      for(; phase < 3; ++phase)
+      {
+        trace_do(marks[phase], step.plan.restore);
+        if(phases[phase])
+          run(phases[phase]);
+      }
+    }
+    catch(const checkpoint_capture&)
+    {
+      auto& f = capture(NodeKind::DoYieldUndo, phase);
+      for(auto& s : saved)
+        f.saved_values.push_back({ slot_name(s.slot), std::move(s.value), std::move(s.contents) });
+      throw;
+    }
+
+    for(auto& s : saved)
+      restore(std::move(s));
+  }
+
+  // Value of a variable before a `do` block. The contents of arrays are copied,
+  //  since the block may change them in place.
+  struct saved_value
+  {
+    std::uint32_t slot;
+    std::optional<DataType> value;
+    std::vector<std::byte> contents;
+  };
+
+  saved_value save(std::uint32_t slot)
+  {
+    saved_value s { slot, std::nullopt, {} };
+    auto* v = vars.find(slot);
+    if(!v)
+      return s;
+
+    s.value = *v;
+    if(auto* arr = std::get_if<array_value::Ptr>(v))
+      s.contents.assign((*arr)->data, (*arr)->data + (*arr)->bytes());
+    return s;
+  }
+
+  void restore(saved_value&& s)
+  {
+    if(auto* cur = vars.find(s.slot))
+      release_memory(memory_of(*cur));
+    if(!s.value)
+    {
+      if(vars.find(s.slot))
+        vars.unbind(s.slot);
+      return;
+    }
+    if(auto* arr = std::get_if<array_value::Ptr>(&*s.value))
+      std::copy(s.contents.begin(), s.contents.end(), (*arr)->data);
+    charge_memory(memory_of(*s.value));
+    vars.set(s.slot, std::move(*s.value));
+  }
+
+  void iterate(std::uint32_t idx, const Node* body, std::size_t beg, std::size_t end)
+  {
+    for(std::size_t i = beg; i < end; ++i)
+    {
+      vars.bind(idx, i);
+      run(body);
+
+      run_check(vars.at(idx) == DataType { i }, "The loop index was changed.");
+      vars.unbind(idx);
+    }
+  }
+
+  array_value& array_of(const Node* n)
+  {
+    if(n->kind == NodeKind::Index)
+      n = n->lhs[0].get();
+
+    auto& v = vars.at(std::get<Object>(n->data).slot);
+    run_check(std::holds_alternative<array_value::Ptr>(v), "Only arrays can be indexed.");
+
+    return *std::get<array_value::Ptr>(v);
+  }
+
+  container_value& container_of(const Node* n)
+  {
+    auto& v = vars.at(std::get<Object>(n->data).slot);
+    run_check(std::holds_alternative<container_value::Ptr>(v), "Not a stack or queue.");
+
+    return *std::get<container_value::Ptr>(v);
+  }
+
+  std::size_t index_of(const Node* n)
+  {
+    return integer(n->lhs[1].get());
+  }
+
+  // Integer expressions are evaluated in place, the operand stack is only used for
+  //  what can't be, e.g. comparisons of arrays. Every node is counted like by `run`.
+  std::size_t integer(const Node* n)
+  {
+    switch(n->kind)
+    {
+    default:
+      break;
+
+    case NodeKind::Num:
+      charge(1);
+      return std::get<std::size_t>(n->data);
+    case NodeKind::Var:
+      charge(1);
+      return std::get<std::size_t>(vars.at(std::get<Object>(n->data).slot));
+    case NodeKind::Index:
+      charge(1);
+      return array_of(n).load(index_of(n));
+    case NodeKind::Arith:
+      charge(1);
+      return arith(n);
+    }
+    run(n);
+    auto v = std::get<std::size_t>(stack.back()); stack.pop_back();
+    return v;
+  }
+
+  // `n` itself is already counted
+  std::size_t arith(const Node* n)
+  {
+    auto a = integer(n->lhs[0].get());
+    auto b = integer(n->lhs[1].get());
+    return ops_of(n, n->typ).binop(std::get<BinOpTypes>(n->data), a, b);
+  }
+
+  // The handlers for `typ`, the type `n` works on. Looked up once per node, every
+  //  interpreter finds the same, so racing workers store the same pointer.
+  static const int_ops& ops_of(const Node* n, const Type::Ptr& typ)
+  {
+    auto* ops = n->ops.load(std::memory_order_relaxed);
+    if(!ops)
+    {
+      ops = &int_ops_for(typ);
+      n->ops.store(ops, std::memory_order_relaxed);
+    }
+    return *ops;
+  }
+
+  // scalar places, either a variable or an array element at an already evaluated index
+  std::size_t load(const Node* n, std::size_t idx)
+  {
+    if(n->kind == NodeKind::Index)
+      return array_of(n).load(idx);
+    return std::get<std::size_t>(vars.at(std::get<Object>(n->data).slot));
+  }
+
+  void store(const Node* n, std::size_t idx, std::size_t cell)
+  {
+    if(n->kind == NodeKind::Index)
+      array_of(n).store(idx, cell);
+    else
+      vars.at(std::get<Object>(n->data).slot) = cell;
+  }
+
+  static DataType make_array(const Type::Ptr& typ, const DataType& init)
+  {
+    auto arr = std::make_shared<array_value>(Type::Array::elem(typ)->kind, Type::Array::length(typ));
+    if(auto src = std::get_if<array_value::Ptr>(&init))
+    {
+      run_check((*src)->elem == arr->elem && (*src)->length == arr->length, "Arrays must have the same type.");
+      std::copy((*src)->data, (*src)->data + arr->bytes(), arr->data);
+    }
+    else
+      arr->fill(std::get<std::size_t>(init));
+    return arr;
+  }
+
+  static DataType normalize(const Type::Ptr& typ, const DataType& val)
+  {
+    if(!typ || !is_int(*typ) || !std::holds_alternative<std::size_t>(val))
+      return val;
+    return int_ops_for(typ).normalize(std::get<std::size_t>(val));
+  }
+
+  void call(Fn* foo, std::vector<DataType>&& args, bool uncall = false)
+  {
+    assert(foo && foo->params.size() == args.size());
+    foo->load();
+
+    if(depth >= lim.max_depth)
+      throw limit_exceeded("call depth exceeds " + std::to_string(lim.max_depth));
+    scoped_count guard(depth);
+
+    const auto kind = (uncall ? NodeKind::Uncall : NodeKind::Call);
+    if(resuming)
+    {
+      // the arguments are among the variables of the checkpoint
+      auto f = resume_frame(kind);
+      run_check(f.fn == foo->name, "Checkpoint doesn't fit the program.");
+    }
+    else
+    {
+      // TODO: Consider export/import
+      //TODO: only let/unlet non-mut args
+      // Let the arguments
+      for(std::size_t i = 0; i < foo->params.size(); ++i)
+      {
+        auto& p = foo->params[i];
+
+        args[i] = normalize(p.type, args[i]);
+        vars.bind(p.slot, args[i]);
+      }
+      check_vars();
+    }
+    // Run function body
+    try
+    {
+      assert((!uncall || foo->inv_body) && "Inverse must be built before running.");
+      if(auto* code = (tier && !resuming ? hot_body(foo, uncall) : nullptr))
+        (*code)(*this);
+      else
+        run(uncall ? foo->inv_body.get() : foo->body.get());
+    }
+    catch(const checkpoint_capture&)
+    {
+      auto& f = capture(kind);
+      f.fn = foo->name;
+      f.args = std::move(args);
+      throw;
+    }
+    // Unlet the arguments
+    for(std::size_t i = 0; i < foo->params.size(); ++i)
+    {
+      auto& p = foo->params[i];
+
+      run_check(vars.at(p.slot) == args[i], "A parameter changed in the call.");
+      vars.unbind(p.slot);
+    }
+  }
+
+  // The compiled body of `foo` once it is called often enough.
+  const stmt_code* hot_body(Fn* foo, bool uncall)
+  {
+    auto& f = local_functions[foo];
+    auto*& code = (uncall ? f.inv_body : f.body);
+    if(code)
+      return code;
+    if(f.calls < tier->hot_calls && ++f.calls < tier->hot_calls)
+      return nullptr;
+
+    std::lock_guard<std::mutex> lock(tier->mut);
+    auto& shared = tier->functions[foo];
+    auto& compiled = (uncall ? shared.inv_body : shared.body);
+    if(!compiled)
+    {
+      compiled = compile_stmt(*this, uncall ? foo->inv_body.get() : foo->body.get());
+      ++tier->promoted_functions;
+    }
+    return code = &compiled;
+  }
+
+  const compiled_loop* compiled_loop_of(const Node* n)
+  {
+    auto it = local_loops.find(n);
+    if(it != local_loops.end())
+      return it->second;
+
+    std::lock_guard<std::mutex> lock(tier->mut);
+    auto pos = tier->loops.find(n);
+    if(pos == tier->loops.end())
+      return nullptr;
+    return local_loops.emplace(n, &pos->second).first->second;
+  }
+
+  // compiles `n` unless another interpreter already did
+  const compiled_loop& promote_loop(const Node* n)
+  {
+    std::lock_guard<std::mutex> lock(tier->mut);
+    auto pos = tier->loops.find(n);
+    if(pos == tier->loops.end())
+    {
+      pos = tier->loops.emplace(n, compile_loop(*this, n)).first;
+      ++tier->promoted_loops;
+    }
+    return *local_loops.emplace(n, &pos->second).first->second;
+  }
+
+  void run_loop(const compiled_loop& l, bool from_start, std::uint64_t iteration)
+  {
+    if(from_start && l.cond1(*this) == 0)
+      return;
+    do
+    {
+      if(tracing)
+        trace::record(trace::event_kind::iteration, 0, iteration, steps());
+      ++iteration;
+
+      l.body(*this);
+    } while(l.cond2(*this) == 0);
+  }
+
+  // accounts for `k` nodes of compiled code or of workers at once
+  void charge(std::size_t k)
+  {
+    while(k >= until_tick)
+    {
+      k -= until_tick;
+      until_tick = 0;
+      tick();
+    }
+    until_tick -= k;
+  }
+
+  // where `read` and `print` go, rebound by every run of a session
+  std::istream* is;
+  std::ostream* os;
+
+  // streams without a buffer, for calls of the host: reads fail and prints are dropped
+  std::istream no_input { nullptr };
+  std::ostream no_output { nullptr };
+  std::vector<DataType> stack;
+  variables vars;
+  std::map<std::string, Fn*> fns;
+
+  // only for pure functions, not used by the workers of parallel loops since those don't call
+  std::size_t memo_budget { 0 };
+  std::map<const Fn*, memo_table> memos;
+
+  // how each `do` block is undone, decided when it first runs
+  std::unordered_map<const Node*, undo_step> undo_steps;
+
+  // how the statements of each block can run in parallel, shared with the workers
+  std::shared_ptr<plan_cache> plans;
+  std::unordered_map<const Node*, const block_plan*> local_plans;
+
+  limits lim;
+  std::size_t steps_left { 0 };
+  std::size_t window { tick_interval };
+  std::size_t until_tick { tick_interval };
+  std::size_t depth { 0 };
+  // bytes of the arrays, stacks and queues bound so far
+  std::size_t memory { 0 };
+  std::size_t executed { 0 };
+  bool tracing { false };
+
+  // Called whenever the fuel of a slice is used up, returns the fuel of the next one.
+  // Only set for the interpreter running `main`, the iterations of a parallel loop
+  //  run to the end of the loop.
+  std::function<std::size_t()> refuel;
+  std::size_t fuel_left { 0 };
+
+  // Only the interpreter running `main` takes checkpoints, outside of parallel code.
+  // `captured` collects the frames while unwinding, innermost first, a resumed run
+  //  goes through the frames of `resume_path` from the outside in.
+  bool checkpoints { false };
+  bool checkpoint_wanted { false };
+  bool checkpoint_due { false };
+  std::size_t no_checkpoints { 0 };
+  std::chrono::milliseconds checkpoint_every { 0 };
+  std::chrono::steady_clock::time_point next_checkpoint;
+  pid_t writer { 0 };
+  std::vector<checkpoint::frame> captured;
+
+  bool resuming { false };
+  std::vector<checkpoint::frame> resume_path;
+  std::size_t resume_at { 0 };
+
+  // compiled code, shared with the workers of parallel code
+  struct hot_function
+  {
+    std::size_t calls { 0 };
+    const stmt_code* body { nullptr };
+    const stmt_code* inv_body { nullptr };
+  };
+  std::shared_ptr<closure_tier> tier;
+  std::unordered_map<const Fn*, hot_function> local_functions;
+  std::unordered_map<const Node*, const compiled_loop*> local_loops;
+};
+
+namespace
+{
+template<typename T, BinOpTypes Op>
+std::size_t baked_binop(std::size_t a, std::size_t b)
+{ return int_kernel<T>::binop(Op, a, b); }
+
+template<typename T, CmpTypes Op>
+std::size_t baked_cmp(std::size_t a, std::size_t b)
+{ return int_kernel<T>::cmp(Op, a, b); }
+
+using int_binop = std::size_t (*)(std::size_t, std::size_t);
+
+int_binop binop_for(const Type::Ptr& typ, BinOpTypes op)
+{
+  return visit_int_kind(typ ? typ->kind : TypeKind::U64, [op](auto t) -> int_binop
+  {
+    using T = decltype(t);
+    switch(op)
+    {
+    case BinOpTypes::Add: return &baked_binop<T, BinOpTypes::Add>;
+    case BinOpTypes::Sub: return &baked_binop<T, BinOpTypes::Sub>;
+    case BinOpTypes::Mul: return &baked_binop<T, BinOpTypes::Mul>;
+    case BinOpTypes::Div: return &baked_binop<T, BinOpTypes::Div>;
+    }
+    return nullptr;
+  });
+}
+
+int_binop cmp_for(const Type::Ptr& typ, CmpTypes op)
+{
+  return visit_int_kind(typ ? typ->kind : TypeKind::U64, [op](auto t) -> int_binop
+  {
+    using T = decltype(t);
+    switch(op)
+    {
+    case CmpTypes::Less:         return &baked_cmp<T, CmpTypes::Less>;
+    case CmpTypes::LessEqual:    return &baked_cmp<T, CmpTypes::LessEqual>;
+    case CmpTypes::Equal:        return &baked_cmp<T, CmpTypes::Equal>;
+    case CmpTypes::InEqual:      return &baked_cmp<T, CmpTypes::InEqual>;
+    case CmpTypes::GreaterEqual: return &baked_cmp<T, CmpTypes::GreaterEqual>;
+    case CmpTypes::Greater:      return &baked_cmp<T, CmpTypes::Greater>;
+    }
+    return nullptr;
+  });
+}
+
+// whether the interpreter would produce an integer for `n`
+bool int_typed(const Node* n)
+{
+  switch(n->kind)
+  {
+  case NodeKind::Num:
+  case NodeKind::Cmp:
+  case NodeKind::Arith:
+  case NodeKind::Size:
+    return true;
+  case NodeKind::Var:
+  case NodeKind::Index:
+    return n->typ && is_int(*n->typ);
+  default:
+    return false;
+  }
+}
+
+// An integer operand. Variables and literals are read in place, everything else
+//  is a closure of its own.
+struct operand
+{
+  enum class kind { num, var, code };
+
+  static operand literal(std::size_t value)
+  {
+    operand op;
+    op.value = value;
+    return op;
+  }
+
+  static operand variable(std::uint32_t slot)
+  {
+    operand op;
+    op.k = kind::var;
+    op.slot = slot;
+    return op;
+  }
+
+  static operand closure(int_code eval)
+  {
+    operand op;
+    op.k = kind::code;
+    op.eval = std::move(eval);
+    return op;
+  }
+
+  kind k { kind::num };
+  std::size_t value { 0 };
+  std::uint32_t slot { 0 };
+  int_code eval;
+
+  std::size_t get(Interpreter& in) const
+  {
+    switch(k)
+    {
+    case kind::num: return value;
+    case kind::var: return std::get<std::size_t>(in.vars.at(slot));
+    case kind::code: break;
+    }
+    return eval(in);
+  }
+
+  // nodes read in place, a closure accounts for its own
+  std::size_t nodes() const
+  { return k == kind::code ? 0 : 1; }
+};
+
+// An argument of a call, an integer or another value of a variable.
+struct argument
+{
+  operand integer;
+  std::size_t (*normalize)(std::size_t);
+  std::optional<std::uint32_t> variable;
+  std::function<Interpreter::DataType(Interpreter&)> other;
+};
+
+// Every closure accounts for the nodes the interpreter would have evaluated for it,
+//  so step limits and slices come out the same.
+struct closure_compiler
+{
+  Interpreter& in;
+
+  operand int_operand(const Node* n)
+  {
+    if(n->kind == NodeKind::Num)
+      return operand::literal(std::get<std::size_t>(n->data));
+    if(n->kind == NodeKind::Var && int_typed(n))
+      return operand::variable(std::get<Object>(n->data).slot);
+    return operand::closure(int_expr(n));
+  }
+
+  int_code int_expr(const Node* n)
+  {
+    switch(n->kind)
+    {
+    default:
+      break;
+
+    case NodeKind::Num:
+    case NodeKind::Var:
+    {
+      if(!int_typed(n))
+        break;
+      ++in.tier->compiled_nodes;
+      return [op = int_operand(n)](Interpreter& in)
+      {
+        in.charge(1);
+        return op.get(in);
+      };
+    }
+    case NodeKind::Index:
+    {
+      if(!int_typed(n))
+        break;
+      ++in.tier->compiled_nodes;
+      return [arr = std::get<Object>(n->lhs[0]->data).slot, idx = int_operand(n->lhs[1].get())](Interpreter& in)
+      {
+        in.charge(1 + idx.nodes());
+        auto& a = *std::get<array_value::Ptr>(in.vars.at(arr));
+        return a.load(idx.get(in));
+      };
+    }
+    case NodeKind::Cmp:
+    {
+      if(!int_typed(n->lhs[0].get()) || !int_typed(n->lhs[1].get()))
+        break;
+      ++in.tier->compiled_nodes;
+      return [a = int_operand(n->lhs[0].get()), b = int_operand(n->lhs[1].get()),
+              f = cmp_for(n->lhs[0]->typ, std::get<CmpTypes>(n->data))](Interpreter& in)
+      {
+        in.charge(1 + a.nodes() + b.nodes());
+        auto y = b.get(in);
+        return f(a.get(in), y);
+      };
+    }
+    case NodeKind::Arith:
+    {
+      if(!int_typed(n->lhs[0].get()) || !int_typed(n->lhs[1].get()))
+        break;
+      ++in.tier->compiled_nodes;
+      return [a = int_operand(n->lhs[0].get()), b = int_operand(n->lhs[1].get()),
+              f = binop_for(n->typ, std::get<BinOpTypes>(n->data))](Interpreter& in)
+      {
+        in.charge(1 + a.nodes() + b.nodes());
+        auto x = a.get(in);
+        return f(x, b.get(in));
+      };
+    }
+    }
+
+    ++in.tier->interpreted_nodes;
+    return [n](Interpreter& in)
+    {
+      in.run(n);
+      auto v = std::get<std::size_t>(in.stack.back()); in.stack.pop_back();
+      return v;
+    };
+  }
+
+  // `extra` nodes are accounted for as well, those of a `Stmt` around a call
+  stmt_code stmt(const Node* n, std::size_t extra = 0)
+  {
+    const std::size_t k = 1 + extra;
+    switch(n->kind)
+    {
+    default:
+      break;
+
+    case NodeKind::Stmt:
+      return stmt(n->lhs[0].get(), k);
+
+    case NodeKind::Block:
+    {
+      auto* plan = in.block_plan_of(n);
+      if(plan && plan->parallel)
+        break;
+
+      std::vector<stmt_code> body;
+      for(auto& s : n->lhs)
+        body.emplace_back(stmt(s.get()));
+      ++in.tier->compiled_nodes;
+      return [body = std::move(body), k](Interpreter& in)
+      {
+        in.charge(k);
+        for(auto& s : body)
+          s(in);
+      };
+    }
+    case NodeKind::Loop:
+    {
+      ++in.tier->compiled_nodes;
+      return [l = compile_loop(in, n), k](Interpreter& in)
+      {
+        in.charge(k);
+        in.run_loop(l, true, 0);
+      };
+    }
+    case NodeKind::If:
+    {
+      auto cond = int_operand(n->lhs[0].get());
+      auto then = stmt(n->lhs[1].get());
+      auto otherwise = (n->lhs.size() > 2 ? stmt(n->lhs[2].get()) : stmt_code());
+      auto exit = int_operand(n->lhs[n->lhs.size() > 3 ? 3 : 0].get());
+      ++in.tier->compiled_nodes;
+      return [cond = std::move(cond), then = std::move(then), otherwise = std::move(otherwise),
+              exit = std::move(exit), k](Interpreter& in)
+      {
+        in.charge(k + cond.nodes());
+        const bool taken = (cond.get(in) != 0);
+        if(taken)
+          then(in);
+        else if(otherwise)
+          otherwise(in);
+        else
+          return;
+        in.charge(exit.nodes());
+        run_check((exit.get(in) != 0) == taken, "The exit condition of an if does not match the branch taken.");
+      };
+    }
+    case NodeKind::OpEq:
+    {
+      auto* target = n->lhs[0].get();
+      if(is_array(n->typ) || !int_typed(n->lhs[1].get()))
+        break;
+
+      auto f = binop_for(n->typ, std::get<BinOpTypes>(n->data));
+      auto rhs = int_operand(n->lhs[1].get());
+      ++in.tier->compiled_nodes;
+      if(target->kind == NodeKind::Var)
+        return [slot = std::get<Object>(target->data).slot, rhs = std::move(rhs), f, k](Interpreter& in)
+        {
+          in.charge(k + rhs.nodes());
+          auto x = rhs.get(in);
+          auto& v = in.vars.at(slot);
+          v = f(std::get<std::size_t>(v), x);
+        };
+      return [arr = std::get<Object>(target->lhs[0]->data).slot, idx = int_operand(target->lhs[1].get()),
+              rhs = std::move(rhs), f, k](Interpreter& in)
+      {
+        in.charge(k + idx.nodes() + rhs.nodes());
+        auto& a = *std::get<array_value::Ptr>(in.vars.at(arr));
+        auto i = idx.get(in);
+        auto x = rhs.get(in);
+        a.store(i, f(a.load(i), x));
+      };
+    }
+    case NodeKind::Let:
+    case NodeKind::Unlet:
+    {
+      if(!n->typ || !is_int(*n->typ) || !int_typed(n->lhs[1].get()))
+        break;
+
+      auto slot = std::get<Object>(n->lhs[0]->data).slot;
+      auto rhs = int_operand(n->lhs[1].get());
+      auto normalize = int_ops_for(n->typ).normalize;
+      ++in.tier->compiled_nodes;
+      if(n->kind == NodeKind::Let)
+        return [slot, rhs = std::move(rhs), normalize, k](Interpreter& in)
+        {
+          in.charge(k + rhs.nodes());
+          auto v = normalize(rhs.get(in));
+          if(in.tracing)
+            trace::record(trace::event_kind::let, slot, v, in.steps());
+          in.vars.bind(slot, v);
+          in.check_vars();
+        };
+      return [slot, rhs = std::move(rhs), normalize, k](Interpreter& in)
+      {
+        in.charge(k + rhs.nodes());
+        auto v = normalize(rhs.get(in));
+        auto& cur = in.vars.at(slot);
+        run_check(cur == Interpreter::DataType { v }, "Unlet of a variable with another value.");
+        if(in.tracing)
+          trace::record(trace::event_kind::unlet, slot, Interpreter::traced(cur), in.steps());
+        in.vars.unbind(slot);
+      };
+    }
+    case NodeKind::Swap:
+    {
+      auto* l = n->lhs[0].get();
+      auto* r = n->lhs[1].get();
+      if(l->kind != NodeKind::Var || r->kind != NodeKind::Var || !int_typed(l) || !int_typed(r))
+        break;
+
+      ++in.tier->compiled_nodes;
+      return [a = std::get<Object>(l->data).slot, b = std::get<Object>(r->data).slot, k](Interpreter& in)
+      {
+        in.charge(k);
+        std::swap(in.vars.at(a), in.vars.at(b));
+      };
+    }
+    case NodeKind::Call:
+    case NodeKind::Uncall:
+    {
+      auto it = in.fns.find(std::get<Object>(n->lhs[1]->data).name);
+      if(it == in.fns.end())
+        break;
+
+      auto* fn = it->second;
+      std::vector<argument> args;
+      std::size_t leaves = 0;
+      for(std::size_t i = 0; i < fn->params.size(); ++i)
+      {
+        auto* a = n->lhs[i + 2].get();
+        auto& typ = fn->params[i].type;
+        if(typ && is_int(*typ) && int_typed(a))
+        {
+          args.push_back({ int_operand(a), int_ops_for(typ).normalize, std::nullopt, nullptr });
+          leaves += args.back().integer.nodes();
+        }
+        else if(a->kind == NodeKind::Var)
+        {
+          args.push_back({ {}, nullptr, std::get<Object>(a->data).slot, nullptr });
+          ++leaves;
+        }
+        else
+        {
+          ++in.tier->interpreted_nodes;
+          args.push_back({ {}, nullptr, std::nullopt, [a](Interpreter& in)
+          {
+            in.run(a);
+            auto v = std::move(in.stack.back()); in.stack.pop_back();
+            return v;
+          } });
+        }
+      }
+      ++in.tier->compiled_nodes;
+      return [fn, args = std::move(args), k = k + leaves, uncall = (n->kind == NodeKind::Uncall),
+              fn_slot = std::get<Object>(n->lhs[1]->data).slot, store = std::get<Object>(n->lhs[0]->data).slot](Interpreter& in)
+      {
+        in.charge(k);
+        std::vector<Interpreter::DataType> values;
+        values.reserve(args.size());
+        for(auto& a : args)
+        {
+          if(a.normalize)
+            values.emplace_back(a.normalize(a.integer.get(in)));
+          else if(a.variable)
+            values.emplace_back(in.vars.at(*a.variable));
+          else
+            values.emplace_back(a.other(in));
+        }
+        in.invoke(fn, fn_slot, store, std::move(values), uncall);
+      };
+    }
+    }
+
+    ++in.tier->interpreted_nodes;
+    if(extra == 0)
+      return [n](Interpreter& in) { in.run(n); };
+    return [n, extra](Interpreter& in)
+    {
+      in.charge(extra);
+      in.run(n);
+    };
+  }
+};
+}
+
+stmt_code compile_stmt(Interpreter& in, const Node* n)
+{
+  return closure_compiler { in }.stmt(n);
+}
+
+compiled_loop compile_loop(Interpreter& in, const Node* n)
+{
+  closure_compiler c { in };
+  return { c.int_expr(n->lhs[0].get()), c.stmt(n->lhs[1].get()), c.int_expr(n->lhs[2].get()) };
+}
+
+session::session(const std::vector<Fn::Ptr>& nods, const interpreter_options& opts)
+  : interp(std::make_unique<Interpreter>(std::cin, std::cout))
+  , opts(opts)
+{
+  for(auto& x : nods)
+  {
+    if(!x->loader && !x->inv_body)
+      x->inv_body = invert(x->body.get());
+    interp->register_fn(x.get());
+  }
+
+  interp->plans = std::make_shared<Interpreter::plan_cache>();
+
+  if((opts.tier_calls != 0 || opts.tier_iterations != 0) && opts.checkpoint_path.empty())
+  {
+    auto or_never = [](std::size_t v) { return v == 0 ? std::numeric_limits<std::size_t>::max() : v; };
+    interp->tier = std::make_shared<closure_tier>();
+    interp->tier->hot_calls = or_never(opts.tier_calls);
+    interp->tier->hot_iterations = or_never(opts.tier_iterations);
+  }
+
+  interp->memo_budget = opts.memo_limit;
+  for(auto* f : pure_functions(nods))
+  {
+    interp->plans->pure.insert(f->name);
+    if(opts.memo_limit > 0)
+      interp->memos.emplace(f, memo_table(interp->memo_budget));
+  }
+
+  // an embedded program may consist of functions for the host only
+  for(auto& x : nods)
+    if(x->name == "main")
+      main = x.get();
+  program = checkpoint::fingerprint(nods);
+}
+
+session::~session()
+{
+  if(opts.memo_stats)
+    for(auto& [f, memo] : interp->memos)
+      std::cerr << "memo " << f->name << ": " << memo.hits << " hits, "
+                << memo.misses << " misses, " << memo.bytes << " bytes\n";
+  if(opts.tier_stats && interp->tier)
+  {
+    auto& t = *interp->tier;
+    std::cerr << "tier: " << t.promoted_functions << " function bodies and " << t.promoted_loops << " loops compiled, "
+              << t.compiled_nodes << " nodes as closures, " << t.interpreted_nodes << " left to the interpreter\n";
+  }
+}
+
+void session::run(std::istream& is, std::ostream& os)
+{
+  run(is, os, 0, nullptr);
+}
+
+void session::run(std::istream& is, std::ostream& os, std::size_t fuel, std::function<std::size_t()> refuel)
+{
+  prepare(is, os);
+  interp->refuel = fuel != 0 ? std::move(refuel) : nullptr;
+  interp->fuel_left = fuel;
+  interp->set_limits(opts);
+  run_main();
+}
+
+bool session::resume(const std::string& path, std::istream& is, std::ostream& os, std::ostream& err)
+{
+  auto state = checkpoint::read(path, err);
+  if(!state)
+    return false;
+  if(state->program != program)
+  {
+    err << "error: checkpoint " << path << " was taken of another program\n";
+    return false;
+  }
+
+  prepare(is, os);
+  interp->set_limits(opts);
+  interp->resume_from(std::move(*state));
+  run_main();
+  return true;
+}
+
+void session::prepare(std::istream& is, std::ostream& os)
+{
+  // the stack keeps its capacity, a run stopped by a limit may have left variables bound
+  interp->is = &is;
+  interp->os = &os;
+  interp->stack.clear();
+  interp->vars.clear();
+  interp->refuel = nullptr;
+  interp->fuel_left = 0;
+}
+
+void session::run_main()
+{
+  run_check(main, "No entry point");
+  // TODO: check main for correct return type
+
+  // TODO: check for argc/argv with correct types
+  run_check(main->params.size() == 1, "Entry point must have exactly one argument.");
+  try
+  {
+    interp->call(main, { std::size_t(0) });
+  }
+  catch(const checkpoint_capture&)
+  {
+    // this is the forked copy, it only writes the checkpoint
+    auto state = interp->snapshot();
+    state.program = program;
+    _exit(checkpoint::write(opts.checkpoint_path, state, std::cerr) ? 0 : 1);
+  }
+  interp->wait_for_checkpoint();
+
+  run_check(interp->vars.empty(), "all lets must be cleaned up with an unlet");
+}
+
+// whether the host's arguments fit the parameters of `f`
+static bool fits(const Fn* f, const host_arg* args, std::size_t n)
+{
+  if(!f || f->params.size() != n)
+    return false;
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    auto& typ = f->params[i].type;
+    if(is_container(typ))
+      return false;
+    if(is_array(typ) && (!args[i].data || args[i].length != Type::Array::length(typ)))
+      return false;
+  }
+  return true;
+}
+
+bool session::call(Fn* f, const host_arg* args, std::size_t n, bool uncall)
+{
+  if(!fits(f, args, n))
+    return false;
+
+  // arrays borrow the host's buffer, so the callee's updates land there directly
+  std::vector<Interpreter::DataType> vals;
+  vals.reserve(n);
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    auto& typ = f->params[i].type;
+    if(is_array(typ))
+      vals.emplace_back(std::make_shared<array_value>(Type::Array::elem(typ)->kind, args[i].length, args[i].data));
+    else
+      vals.emplace_back(std::size_t(args[i].value));
+  }
+
+  prepare(interp->no_input, interp->no_output);
+  interp->set_limits(opts);
+  interp->checkpoints = false;
+
+  interp->call(f, std::move(vals), uncall);
+
+  run_check(interp->vars.empty(), "all lets must be cleaned up with an unlet");
+  return true;
+}
+
+// Lanes work on copies of the arrays, which only ends up like running the tuples one
+//  after the other if no two of them share memory.
+static bool disjoint_arrays(const Fn* f, const host_arg* args, std::size_t count)
+{
+  const auto n = f->params.size();
+  std::vector<std::pair<const std::byte*, const std::byte*>> ranges;
+  for(std::size_t t = 0; t < count; ++t)
+    for(std::size_t i = 0; i < n; ++i)
+    {
+      auto& typ = f->params[i].type;
+      if(!is_array(typ))
+        continue;
+      auto* data = static_cast<const std::byte*>(args[t * n + i].data);
+      ranges.emplace_back(data, data + args[t * n + i].length * int_ops_for(Type::Array::elem(typ)).width);
+    }
+  std::sort(ranges.begin(), ranges.end());
+  for(std::size_t k = 1; k < ranges.size(); ++k)
+    if(ranges[k].first < ranges[k - 1].second)
+      return false;
+  return true;
+}
+
+bool session::call_each(Fn* f, const host_arg* args, std::size_t count, bool uncall)
+{
+  const auto n = (f ? f->params.size() : 0);
+  for(std::size_t t = 0; t < count; ++t)
+    if(!fits(f, args + t * n, n))
+      return false;
+
+  // a group that fails runs again one tuple at a time, so the tuples before the
+  //  failing one are done and the error is its own, as without lockstep
+  std::size_t done = 0;
+  if(opts.lockstep && count > 1)
+  {
+    auto it = lockstep_fits.find(f);
+    if(it == lockstep_fits.end())
+      it = lockstep_fits.emplace(f, lockstep::supports(f, interp->fns)).first;
+    if(it->second && disjoint_arrays(f, args, count))
+      done = lockstep::run(f, interp->fns, args, count, uncall, opts);
+  }
+  for(std::size_t t = done; t < count; ++t)
+    call(f, args + t * n, n, uncall);
+  return true;
+}
+
+std::size_t session::steps() const
+{
+  return interp->steps();
+}
+
+void interpret(std::ostream& os, const std::vector<Fn::Ptr>& nods, const interpreter_options& opts)
+{
+  session(nods, opts).run(std::cin, os);
+}
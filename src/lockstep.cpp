@@ -0,0 +1,807 @@
+#include <int_kernels.hpp>
+#include <run_error.hpp>
+#include <lockstep.hpp>
+#include <array.hpp>
+
+#include <unordered_map>
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <set>
+
+namespace lockstep
+{
+// One 64 bit cell per lane. Every operation is a loop over all lanes of a fixed count,
+//  which the compiler turns into vector instructions as wide as the target has.
+struct cells
+{
+  std::uint64_t& operator[](std::size_t l)
+  { return lane[l]; }
+
+  std::uint64_t operator[](std::size_t l) const
+  { return lane[l]; }
+
+  std::uint64_t lane[lane_count];
+};
+
+// all bits set in the lanes taking part, comparisons yield one
+using mask = cells;
+
+template<typename F>
+static cells lanewise(const cells& a, const cells& b, F f)
+{
+  cells r;
+  for(std::size_t l = 0; l < lane_count; ++l)
+    r[l] = f(a[l], b[l]);
+  return r;
+}
+
+static cells splat(std::uint64_t x)
+{
+  cells r;
+  for(std::size_t l = 0; l < lane_count; ++l)
+    r[l] = x;
+  return r;
+}
+
+static std::uint64_t truth(bool b)
+{ return -std::uint64_t(b); }
+
+static cells operator+(const cells& a, const cells& b)
+{ return lanewise(a, b, [](std::uint64_t x, std::uint64_t y) { return x + y; }); }
+
+static cells operator-(const cells& a, const cells& b)
+{ return lanewise(a, b, [](std::uint64_t x, std::uint64_t y) { return x - y; }); }
+
+static cells operator*(const cells& a, const cells& b)
+{ return lanewise(a, b, [](std::uint64_t x, std::uint64_t y) { return x * y; }); }
+
+static cells operator&(const cells& a, const cells& b)
+{ return lanewise(a, b, [](std::uint64_t x, std::uint64_t y) { return x & y; }); }
+
+static cells operator|(const cells& a, const cells& b)
+{ return lanewise(a, b, [](std::uint64_t x, std::uint64_t y) { return x | y; }); }
+
+static cells operator~(const cells& a)
+{ return lanewise(a, a, [](std::uint64_t x, std::uint64_t) { return ~x; }); }
+
+static cells& operator&=(cells& a, const cells& b)
+{ return a = a & b; }
+
+static cells& operator|=(cells& a, const cells& b)
+{ return a = a | b; }
+
+static mask operator==(const cells& a, const cells& b)
+{ return lanewise(a, b, [](std::uint64_t x, std::uint64_t y) { return truth(x == y); }); }
+
+static mask operator!=(const cells& a, const cells& b)
+{ return lanewise(a, b, [](std::uint64_t x, std::uint64_t y) { return truth(x != y); }); }
+
+static bool any(const mask& m)
+{
+  std::uint64_t bits = 0;
+  for(std::size_t l = 0; l < lane_count; ++l)
+    bits |= m[l];
+  return bits != 0;
+}
+
+// `a` in the lanes of `m`, `b` in the others
+static cells select(const mask& m, const cells& a, const cells& b)
+{ return (a & m) | (b & ~m); }
+
+static TypeKind kind_of(const Type::Ptr& typ)
+{ return typ ? typ->kind : TypeKind::U64; }
+
+// sign- resp. zero-extends every lane like `int_kernel::normalize`
+static cells wrap(TypeKind kind, const cells& v)
+{
+  return visit_int_kind(kind, [&v](auto t) {
+      return lanewise(v, v, [](std::uint64_t x, std::uint64_t) { return int_kernel<decltype(t)>::normalize(x); });
+    });
+}
+
+static cells binop(TypeKind kind, BinOpTypes op, cells a, const cells& b, const mask& m)
+{
+  switch(op)
+  {
+  case BinOpTypes::Add: return wrap(kind, a + b);
+  case BinOpTypes::Sub: return wrap(kind, a - b);
+  case BinOpTypes::Mul: return wrap(kind, a * b);
+  case BinOpTypes::Div: break;
+  }
+  // there is no vector division, and lanes not taking part may divide by zero
+  auto& ops = int_ops_for(kind);
+  for(std::size_t l = 0; l < lane_count; ++l)
+    if(m[l])
+      a[l] = ops.binop(op, a[l], b[l]);
+  return a;
+}
+
+// cells of signed kinds are sign-extended, so they compare as signed 64 bit integers
+template<typename T>
+static mask compare_as(CmpTypes op, const cells& a, const cells& b)
+{
+  switch(op)
+  {
+  case CmpTypes::Less:         return lanewise(a, b, [](T x, T y) { return truth(x < y); });
+  case CmpTypes::LessEqual:    return lanewise(a, b, [](T x, T y) { return truth(x <= y); });
+  case CmpTypes::Equal:        return a == b;
+  case CmpTypes::InEqual:      return a != b;
+  case CmpTypes::GreaterEqual: return lanewise(a, b, [](T x, T y) { return truth(x >= y); });
+  case CmpTypes::Greater:      return lanewise(a, b, [](T x, T y) { return truth(x > y); });
+  }
+  return mask {};
+}
+
+static mask compare(TypeKind kind, CmpTypes op, const cells& a, const cells& b)
+{
+  if(kind == TypeKind::U64)
+    return compare_as<std::uint64_t>(op, a, b);
+  return compare_as<std::int64_t>(op, a, b);
+}
+
+struct lane_array
+{
+  lane_array(TypeKind elem, std::size_t length)
+    : elem(elem)
+    , rows(length)
+  {  }
+
+  TypeKind elem;
+
+  // element `i` of lane `l` is `rows[i][l]`, so updating one element is one vector operation
+  std::vector<cells> rows;
+};
+
+enum class value_kind : std::uint8_t
+{
+  unit,
+  num,
+  array,
+};
+
+struct value
+{
+  value_kind kind { value_kind::unit };
+  cells num {};
+  std::shared_ptr<lane_array> arr;
+};
+
+// Variables are bound per lane, a `let` in one branch of an `if` only binds it in the
+//  lanes taking that branch. All lanes share the array of an array variable.
+struct variable : value
+{
+  mask bound {};
+};
+
+static std::uint32_t slot(const Node* n)
+{ return std::get<Object>(n->data).slot; }
+
+namespace
+{
+class group
+{
+public:
+  group(const std::map<std::string, Fn*>& fns, const interpreter_options& opts)
+    : fns(fns)
+    , opts(opts)
+  {  }
+
+  // resets the limits for the next group of tuples
+  void start()
+  {
+    depth = 0;
+    used = cells {};
+    memory = cells {};
+    deadline = std::chrono::steady_clock::now() + opts.timeout;
+    until_tick = next_window();
+  }
+
+  bool idle() const
+  { return live == 0; }
+
+  void call(Fn* f, std::vector<value> args, mask m, bool uncall)
+  {
+    f->load();
+    if(opts.max_call_depth != 0 && depth >= opts.max_call_depth)
+      throw limit_exceeded("call depth exceeds " + std::to_string(opts.max_call_depth));
+    ++depth;
+
+    for(std::size_t i = 0; i < f->params.size(); ++i)
+    {
+      auto& p = f->params[i];
+      if(args[i].kind == value_kind::num)
+        args[i].num = wrap(kind_of(p.type), args[i].num);
+      bind(p.slot, args[i], m, true);
+    }
+
+    assert((!uncall || f->inv_body) && "Inverse must be built before running.");
+    exec(uncall ? f->inv_body.get() : f->body.get(), m);
+
+    for(std::size_t i = 0; i < f->params.size(); ++i)
+    {
+      auto& p = f->params[i];
+      auto& v = at(p.slot, m);
+      run_check(v.arr == args[i].arr && (v.kind != value_kind::num || !any(m & (v.num != args[i].num))),
+                "A parameter changed in the call.");
+      unbind(p.slot, m);
+    }
+    --depth;
+  }
+
+private:
+  static constexpr std::size_t tick_interval = 1 << 16;
+
+  // steps of the lane that ran the most nodes so far
+  std::size_t most_used() const
+  { return *std::max_element(std::begin(used.lane), std::end(used.lane)); }
+
+  // no lane can run out of steps before the window is over
+  std::size_t next_window() const
+  { return opts.max_steps != 0 ? std::min(tick_interval, opts.max_steps - most_used()) : tick_interval; }
+
+  // Every lane in `m` is charged for the node, like its tuple would be on its own. The
+  //  step budget and the clock are only looked at every so often.
+  void step(const mask& m)
+  {
+    if(opts.max_steps != 0)
+      used = used - m;
+    if(--until_tick == 0)
+      tick();
+  }
+
+  // Every lane in `m` binds an array of `bytes`, checked against the limit of its tuple
+  //  before the group allocates it for all lanes.
+  void charge_memory(std::size_t bytes, const mask& m)
+  {
+    if(opts.max_memory == 0)
+      return;
+    for(std::size_t l = 0; l < lane_count; ++l)
+      if(m[l] && bytes > opts.max_memory - memory[l])
+        throw limit_exceeded("arrays, stacks and queues exceed " + std::to_string(opts.max_memory) + " bytes");
+    memory = memory + (m & splat(bytes));
+  }
+
+  // the lanes share arrays of the host, which were never charged
+  void release_memory(std::size_t bytes, const mask& m)
+  { memory = memory - (m & lanewise(memory, splat(bytes), [](std::uint64_t x, std::uint64_t y) { return std::min(x, y); })); }
+
+  void tick()
+  {
+    if(opts.max_steps != 0 && most_used() >= opts.max_steps)
+      throw limit_exceeded("step limit reached");
+    if(opts.timeout.count() != 0 && std::chrono::steady_clock::now() > deadline)
+      throw limit_exceeded("time limit reached");
+    until_tick = next_window();
+  }
+
+  variable& at(std::uint32_t s, mask m)
+  {
+    run_check(s < vars.size() && !any(m & ~vars[s].bound), "Unbound variable!");
+    return vars[s];
+  }
+
+  variable& slot_at(std::uint32_t s)
+  {
+    if(s >= vars.size())
+      vars.resize(std::max<std::size_t>(s + 1, slot_count()));
+    return vars[s];
+  }
+
+  // Parameters are bound `by_reference`, the lanes then share the caller's array.
+  void bind(std::uint32_t s, const value& val, mask m, bool by_reference = false)
+  {
+    auto& v = slot_at(s);
+    run_check(!any(v.bound & m), "Variable is already bound.");
+    if(!any(v.bound))
+    {
+      static_cast<value&>(v) = val;
+      ++live;
+    }
+    else
+    {
+      // bound in other lanes already, by a branch these didn't take
+      run_check(v.kind == val.kind, "Lanes bind a variable to values of different types.");
+      v.num = select(m, val.num, v.num);
+      if(v.arr != val.arr)
+      {
+        run_check(!by_reference, "Lanes pass different arrays for one parameter.");
+        for(std::size_t i = 0; i < v.arr->rows.size(); ++i)
+          v.arr->rows[i] = select(m, val.arr->rows[i], v.arr->rows[i]);
+      }
+    }
+    v.bound |= m;
+  }
+
+  void unbind(std::uint32_t s, mask m)
+  {
+    auto& v = at(s, m);
+    v.bound &= ~m;
+    if(!any(v.bound))
+    {
+      v.arr.reset();
+      --live;
+    }
+  }
+
+  // what a call leaves in the variable it is assigned to
+  void set_unit(std::uint32_t s, mask m)
+  {
+    auto& v = slot_at(s);
+    if(!any(v.bound))
+    {
+      v.kind = value_kind::unit;
+      ++live;
+    }
+    else if(!any(v.bound & ~m))
+    {
+      v.kind = value_kind::unit;
+      v.arr.reset();
+    }
+    run_check(v.kind == value_kind::unit, "Lanes bind a variable to values of different types.");
+    v.bound |= m;
+  }
+
+  lane_array& array_of(const Node* n, mask m)
+  {
+    if(n->kind == NodeKind::Index)
+      n = n->lhs[0].get();
+
+    auto& v = at(slot(n), m);
+    run_check(v.arr != nullptr, "Only arrays can be indexed.");
+    return *v.arr;
+  }
+
+  // the element all lanes of `m` index, if it is the same one
+  static bool same_index(cells idx, mask m, std::size_t& row)
+  {
+    bool first = true;
+    for(std::size_t l = 0; l < lane_count; ++l)
+    {
+      if(!m[l])
+        continue;
+      if(!first && idx[l] != row)
+        return false;
+      row = idx[l];
+      first = false;
+    }
+    return true;
+  }
+
+  // scalar places, either a variable or an array element at already evaluated indices
+  cells load(const Node* n, cells idx, mask m)
+  {
+    if(n->kind != NodeKind::Index)
+      return at(slot(n), m).num;
+
+    auto& arr = array_of(n, m);
+    std::size_t i = 0;
+    if(same_index(idx, m, i))
+    {
+      run_check(i < arr.rows.size(), "Array index out of bounds.");
+      return arr.rows[i];
+    }
+    cells r {};
+    for(std::size_t l = 0; l < lane_count; ++l)
+      if(m[l])
+      {
+        run_check(idx[l] < arr.rows.size(), "Array index out of bounds.");
+        r[l] = arr.rows[idx[l]][l];
+      }
+    return r;
+  }
+
+  void store(const Node* n, cells idx, cells c, mask m)
+  {
+    if(n->kind != NodeKind::Index)
+    {
+      auto& v = at(slot(n), m);
+      v.num = select(m, c, v.num);
+      return;
+    }
+    auto& arr = array_of(n, m);
+    for(std::size_t l = 0; l < lane_count; ++l)
+      if(m[l])
+      {
+        run_check(idx[l] < arr.rows.size(), "Array index out of bounds.");
+        arr.rows[idx[l]][l] = c[l];
+      }
+  }
+
+  // integer expressions, without going through a `value`
+  cells num(const Node* n, mask m)
+  {
+    step(m);
+    switch(n->kind)
+    {
+    case NodeKind::Num:
+      return splat(std::get<std::size_t>(n->data));
+    case NodeKind::Var:
+      return at(slot(n), m).num;
+    case NodeKind::Index:
+      return load(n, num(n->lhs[1].get(), m), m);
+    case NodeKind::Cmp:
+    {
+      auto a = num(n->lhs[0].get(), m);
+      auto b = num(n->lhs[1].get(), m);
+      return compare(kind_of(n->lhs[0]->typ), std::get<CmpTypes>(n->data), a, b) & splat(1);
+    }
+    case NodeKind::Arith:
+    {
+      auto a = num(n->lhs[0].get(), m);
+      auto b = num(n->lhs[1].get(), m);
+      return binop(kind_of(n->typ), std::get<BinOpTypes>(n->data), a, b, m);
+    }
+    }
+    return cells {};
+  }
+
+  // arrays are shared, not copied
+  value eval(const Node* n, mask m)
+  {
+    if(n->kind == NodeKind::Var)
+    {
+      step(m);
+      return at(slot(n), m);
+    }
+    if(n->kind == NodeKind::Unit)
+    {
+      step(m);
+      return {};
+    }
+    return { value_kind::num, num(n, m), nullptr };
+  }
+
+  // what `let` binds: integers normalized, arrays copied or filled
+  static value fresh(const Type::Ptr& typ, const value& init)
+  {
+    if(is_array(typ))
+    {
+      auto arr = std::make_shared<lane_array>(Type::Array::elem(typ)->kind, Type::Array::length(typ));
+      if(init.arr)
+      {
+        run_check(init.arr->rows.size() == arr->rows.size(), "Arrays must have the same type.");
+        arr->rows = init.arr->rows;
+      }
+      else
+        std::fill(arr->rows.begin(), arr->rows.end(), wrap(arr->elem, init.num));
+      return { value_kind::array, cells {}, std::move(arr) };
+    }
+    if(typ && is_int(*typ))
+      return { value_kind::num, wrap(typ->kind, init.num), nullptr };
+    return {};
+  }
+
+  void exec(const Node* n, mask m)
+  {
+    step(m);
+    switch(n->kind)
+    {
+    case NodeKind::Stmt:
+      exec(n->lhs[0].get(), m);
+      return;
+    case NodeKind::Block:
+      for(auto& s : n->lhs)
+        exec(s.get(), m);
+      return;
+    case NodeKind::OpEq:
+      update(n, m);
+      return;
+    case NodeKind::Let:
+      if(is_store(n))
+        set_unit(slot(n->lhs[0].get()), m);
+      else
+      {
+        auto init = eval(n->lhs[1].get(), m);
+        if(is_array(n->typ))
+          charge_memory(array_bytes(Type::Array::elem(n->typ)->kind, Type::Array::length(n->typ)), m);
+        bind(slot(n->lhs[0].get()), fresh(n->typ, init), m);
+      }
+      return;
+    case NodeKind::Unlet:
+      unlet(n, m);
+      return;
+    case NodeKind::Swap:
+      swap(n, m);
+      return;
+    case NodeKind::If:
+    {
+      const mask taken = (num(n->lhs[0].get(), m) != cells {});
+      if(any(m & taken))
+        exec(n->lhs[1].get(), m & taken);
+      if(n->lhs.size() > 2 && any(m & ~taken))
+        exec(n->lhs[2].get(), m & ~taken);
+
+      // lanes that ran a branch must still agree with the exit condition
+      const mask ran = (n->lhs.size() > 2 ? m : m & taken);
+      if(any(ran))
+      {
+        const mask held = (num(n->lhs[n->lhs.size() > 3 ? 3 : 0].get(), ran) != cells {});
+        run_check(!any(ran & (held != taken)), "The exit condition of an if does not match the branch taken.");
+      }
+      return;
+    }
+    case NodeKind::Loop:
+    {
+      // lanes leave the loop one by one, it is done once the last one did
+      mask running = m & (num(n->lhs[0].get(), m) != cells {});
+      while(any(running))
+      {
+        exec(n->lhs[1].get(), running);
+        running &= (num(n->lhs[2].get(), running) == cells {});
+      }
+      return;
+    }
+    case NodeKind::DoYieldUndo:
+      exec(n->lhs[0].get(), m);
+      exec(n->lhs[1].get(), m);
+      exec(inverse_of(n), m);
+      return;
+    case NodeKind::Call:
+    case NodeKind::Uncall:
+    {
+      auto* fn = fns.at(std::get<Object>(n->lhs[1]->data).name);
+      run_check(fn->params.size() == n->lhs.size() - 2, "function call arguments must match");
+
+      std::vector<value> args;
+      args.reserve(fn->params.size());
+      for(std::size_t i = 0; i < fn->params.size(); ++i)
+        args.emplace_back(eval(n->lhs[i + 2].get(), m));
+      call(fn, std::move(args), m, n->kind == NodeKind::Uncall);
+      set_unit(slot(n->lhs[0].get()), m);
+      return;
+    }
+    }
+    assert(false && "Statement cannot run in lockstep.");
+  }
+
+  void update(const Node* n, mask m)
+  {
+    auto op = std::get<BinOpTypes>(n->data);
+    auto* place = n->lhs[0].get();
+    if(is_array(n->typ))
+    {
+      // element-wise, either with another array or broadcasting a scalar
+      auto& arr = array_of(place, m);
+      auto rhs = eval(n->lhs[1].get(), m);
+      run_check(rhs.arr.get() != &arr, "Element-wise update of an array with itself is not reversible.");
+      for(std::size_t i = 0; i < arr.rows.size(); ++i)
+      {
+        auto& row = arr.rows[i];
+        row = select(m, binop(arr.elem, op, row, rhs.arr ? rhs.arr->rows[i] : rhs.num, m), row);
+      }
+      return;
+    }
+    if(place->kind == NodeKind::Index)
+    {
+      auto& arr = array_of(place, m);
+      auto idx = num(place->lhs[1].get(), m);
+      auto rhs = num(n->lhs[1].get(), m);
+
+      std::size_t i = 0;
+      if(same_index(idx, m, i))
+      {
+        run_check(i < arr.rows.size(), "Array index out of bounds.");
+        arr.rows[i] = select(m, binop(arr.elem, op, arr.rows[i], rhs, m), arr.rows[i]);
+        return;
+      }
+      auto& ops = int_ops_for(arr.elem);
+      for(std::size_t l = 0; l < lane_count; ++l)
+        if(m[l])
+        {
+          run_check(idx[l] < arr.rows.size(), "Array index out of bounds.");
+          auto& cell = arr.rows[idx[l]][l];
+          cell = ops.binop(op, cell, rhs[l]);
+        }
+      return;
+    }
+    auto rhs = num(n->lhs[1].get(), m);
+    auto& v = at(slot(place), m);
+    v.num = select(m, binop(kind_of(n->typ), op, v.num, rhs, m), v.num);
+  }
+
+  void unlet(const Node* n, mask m)
+  {
+    auto s = slot(n->lhs[0].get());
+    auto val = eval(n->lhs[1].get(), m);
+
+    auto& cur = at(s, m);
+    if(cur.arr)
+    {
+      for(std::size_t i = 0; i < cur.arr->rows.size(); ++i)
+      {
+        auto expected = (val.arr ? val.arr->rows[i] : wrap(cur.arr->elem, val.num));
+        run_check(!any(m & (cur.arr->rows[i] != expected)), "Unlet of an array with other contents.");
+      }
+      release_memory(array_bytes(cur.arr->elem, cur.arr->rows.size()), m);
+    }
+    else if(cur.kind == value_kind::num)
+      run_check(!any(m & (cur.num != wrap(kind_of(n->typ), val.num))), "Unlet of a variable with another value.");
+    unbind(s, m);
+  }
+
+  void swap(const Node* n, mask m)
+  {
+    auto* l = n->lhs[0].get();
+    auto* r = n->lhs[1].get();
+    if(l->kind == NodeKind::Var && r->kind == NodeKind::Var)
+    {
+      auto& a = at(slot(l), m);
+      auto& b = at(slot(r), m);
+      if(a.arr && b.arr)
+      {
+        if(a.arr != b.arr)
+          for(std::size_t i = 0; i < a.arr->rows.size(); ++i)
+          {
+            auto x = a.arr->rows[i];
+            a.arr->rows[i] = select(m, b.arr->rows[i], x);
+            b.arr->rows[i] = select(m, x, b.arr->rows[i]);
+          }
+        return;
+      }
+      auto x = a.num;
+      a.num = select(m, b.num, x);
+      b.num = select(m, x, b.num);
+      return;
+    }
+    // evaluate both places before touching either of them
+    auto lidx = (l->kind == NodeKind::Index ? num(l->lhs[1].get(), m) : cells {});
+    auto ridx = (r->kind == NodeKind::Index ? num(r->lhs[1].get(), m) : cells {});
+    auto a = load(l, lidx, m);
+    auto b = load(r, ridx, m);
+    store(l, lidx, b, m);
+    store(r, ridx, a, m);
+  }
+
+  const Node* inverse_of(const Node* n)
+  {
+    auto& inv = inverses[n];
+    if(!inv)
+      inv = invert(n->lhs[0].get());
+    return inv.get();
+  }
+
+  const std::map<std::string, Fn*>& fns;
+  const interpreter_options& opts;
+
+  std::vector<variable> vars;
+  std::size_t live { 0 };
+
+  // what undoes the `do` block of each `do`/`yield`/`undo`
+  std::unordered_map<const Node*, Node::Ptr> inverses;
+
+  std::size_t depth { 0 };
+  // nodes run by each lane, a mask counts one in each lane it holds
+  cells used {};
+  // bytes of the arrays each lane bound
+  cells memory {};
+  std::size_t until_tick { tick_interval };
+  std::chrono::steady_clock::time_point deadline;
+};
+}
+
+static bool fits(const Node* n, const std::map<std::string, Fn*>& fns, std::vector<Fn*>& callees)
+{
+  if(!n)
+    return true;
+  switch(n->kind)
+  {
+  case NodeKind::ParFor:
+  case NodeKind::Push:
+  case NodeKind::Pop:
+  case NodeKind::Size:
+  case NodeKind::Top:
+    return false;
+  case NodeKind::Let:
+  case NodeKind::Unlet:
+    if(is_container(n->typ))
+      return false;
+    break;
+  case NodeKind::Cmp:
+    if(n->lhs[0]->typ && !is_int(*n->lhs[0]->typ))
+      return false;
+    break;
+  case NodeKind::Call:
+  case NodeKind::Uncall:
+  {
+    // builtins are `print` and `read`
+    auto it = fns.find(std::get<Object>(n->lhs[1]->data).name);
+    if(it == fns.end())
+      return false;
+    callees.push_back(it->second);
+    break;
+  }
+  }
+  return std::all_of(n->lhs.begin(), n->lhs.end(), [&](auto& x) { return fits(x.get(), fns, callees); });
+}
+
+bool supports(Fn* f, const std::map<std::string, Fn*>& fns)
+{
+  std::set<const Fn*> seen;
+  std::vector<Fn*> todo { f };
+  while(!todo.empty())
+  {
+    auto* g = todo.back();
+    todo.pop_back();
+    if(!seen.insert(g).second)
+      continue;
+
+    g->load();
+    for(auto& p : g->params)
+      if(is_container(p.type))
+        return false;
+    if(!fits(g->body.get(), fns, todo) || !fits(g->inv_body.get(), fns, todo))
+      return false;
+  }
+  return true;
+}
+
+std::size_t run(Fn* f, const std::map<std::string, Fn*>& fns, const host_arg* args, std::size_t count,
+                bool uncall, const interpreter_options& opts)
+{
+  group g(fns, opts);
+  const auto n = f->params.size();
+  for(std::size_t first = 0; first < count; first += lane_count)
+  {
+    const auto* tuples = args + first * n;
+    const auto lanes = std::min(lane_count, count - first);
+    mask m {};
+    for(std::size_t l = 0; l < lanes; ++l)
+      m[l] = truth(true);
+
+    // arrays are copied into lanes and back, the host's buffers are one per tuple
+    std::vector<value> vals;
+    vals.reserve(n);
+    for(std::size_t i = 0; i < n; ++i)
+    {
+      auto& typ = f->params[i].type;
+      if(is_array(typ))
+      {
+        auto arr = std::make_shared<lane_array>(Type::Array::elem(typ)->kind, Type::Array::length(typ));
+        for(std::size_t l = 0; l < lanes; ++l)
+        {
+          array_value buf(arr->elem, arr->rows.size(), tuples[l * n + i].data);
+          for(std::size_t k = 0; k < arr->rows.size(); ++k)
+            arr->rows[k][l] = buf.load(k);
+        }
+        vals.push_back({ value_kind::array, cells {}, std::move(arr) });
+      }
+      else
+      {
+        cells c {};
+        for(std::size_t l = 0; l < lanes; ++l)
+          c[l] = tuples[l * n + i].value;
+        vals.push_back({ value_kind::num, c, nullptr });
+      }
+    }
+
+    // the lanes only worked on copies, the host's buffers are as before the group
+    try
+    {
+      g.start();
+      g.call(f, vals, m, uncall);
+      run_check(g.idle(), "all lets must be cleaned up with an unlet");
+    }
+    catch(const std::exception&)
+    {
+      return first;
+    }
+
+    for(std::size_t i = 0; i < n; ++i)
+    {
+      auto& arr = vals[i].arr;
+      if(!arr)
+        continue;
+      for(std::size_t l = 0; l < lanes; ++l)
+      {
+        array_value buf(arr->elem, arr->rows.size(), tuples[l * n + i].data);
+        for(std::size_t k = 0; k < arr->rows.size(); ++k)
+          buf.store(k, arr->rows[k][l]);
+      }
+    }
+  }
+  return count;
+}
+}
@@ -1,29 +1,415 @@
-#include <parser.hpp>
+#include <module_loader.hpp>
+#include <module_file.hpp>
+#include <thread_pool.hpp>
+#include <checkpoint.hpp>
+#include <scheduler.hpp>
 #include <interpret.hpp>
-#include <type.hpp>
+#include <optimize.hpp>
+#include <passes.hpp>
+#include <server.hpp>
+#include <batch.hpp>
+#include <trace.hpp>
+#include <array.hpp>
 
+#include <string_view>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
+#include <csignal>
 
-int main(int argc, char** argv)
+// checkpoints are only taken of a plain run
+struct checkpointing
+{
+  std::string path;
+  std::chrono::milliseconds every { 0 };
+  std::string resume_from;
+};
+
+// `--each FN TUPLES` calls one function on every line of a file instead of running `main`
+struct each_call
+{
+  std::string fn;
+  std::string tuples;
+};
+
+// A line has a number per integer parameter and one per element of an array parameter.
+// Every tuple is printed the same way after its call, with the arrays updated.
+static bool run_each(const std::vector<Fn::Ptr>& v, const interpreter_options& opts, const each_call& each)
+{
+  auto it = std::find_if(v.begin(), v.end(), [&each](auto& f) { return f->name == each.fn; });
+  if(it == v.end())
+  {
+    std::cerr << "error: there is no function " << each.fn << "\n";
+    return false;
+  }
+  auto* f = it->get();
+  std::ifstream in(each.tuples);
+  if(!in)
+  {
+    std::cerr << "error: cannot read " << each.tuples << "\n";
+    return false;
+  }
+
+  std::vector<host_arg> args;
+  std::vector<array_value::Ptr> arrays;
+  std::size_t line_no = 0;
+  for(std::string line; std::getline(in, line); )
+  {
+    ++line_no;
+    if(line.find_first_not_of(" \t") == std::string::npos)
+      continue;
+    std::istringstream is(line);
+    for(auto& p : f->params)
+    {
+      host_arg a;
+      if(is_array(p.type))
+      {
+        auto& arr = arrays.emplace_back(std::make_shared<array_value>(Type::Array::elem(p.type)->kind, Type::Array::length(p.type)));
+        for(std::size_t k = 0; k < arr->length; ++k)
+        {
+          std::size_t x = 0;
+          is >> x;
+          arr->store(k, x);
+        }
+        a = host_arg { 0, arr->data, arr->length };
+      }
+      else
+        is >> a.value;
+      args.push_back(a);
+    }
+    std::string rest;
+    if(!is || is >> rest)
+    {
+      std::cerr << "error: " << each.tuples << ":" << line_no << " doesn't fit the parameters of " << f->name << "\n";
+      return false;
+    }
+  }
+
+  session sess(v, opts);
+  if(!sess.call_each(f, args.data(), args.size() / std::max<std::size_t>(f->params.size(), 1)))
+  {
+    std::cerr << "error: the tuples don't fit the parameters of " << f->name << "\n";
+    return false;
+  }
+  for(std::size_t i = 0; i < args.size(); ++i)
+  {
+    auto& p = f->params[i % f->params.size()];
+    std::cout << (i % f->params.size() == 0 ? "" : " ");
+    if(is_array(p.type))
+    {
+      array_value arr(Type::Array::elem(p.type)->kind, args[i].length, args[i].data);
+      for(std::size_t k = 0; k < arr.length; ++k)
+      {
+        std::cout << (k == 0 ? "" : " ");
+        int_ops_for(arr.elem).print(std::cout, arr.load(k));
+      }
+    }
+    else
+    {
+      auto& ops = int_ops_for(p.type);
+      ops.print(std::cout, ops.normalize(args[i].value));
+    }
+    if((i + 1) % f->params.size() == 0)
+      std::cout << "\n";
+  }
+  return true;
+}
+
+// nodes of the bodies and inverses loaded so far
+static std::size_t program_nodes(const std::vector<Fn::Ptr>& v)
+{
+  std::size_t n = 0;
+  for(auto& f : v)
+    n += node_count(f->body.get()) + node_count(f->inv_body.get());
+  return n;
+}
+
+static void optimize(std::vector<Fn::Ptr>& v, bool lazy, std::size_t specialize_nodes)
+{
+  // both would parse every body reachable from `main` up front
+  if(lazy)
+    return;
+  passes::scope timed(passes::phase::optimize);
+  // copies for literal arguments are inlined like any other callee
+  if(passes::enabled("specialize"))
+    specialize_calls(v, specialize_nodes);
+  if(passes::enabled("inline"))
+    inline_calls(v);
+  if(passes::measuring())
+    passes::add_nodes(passes::phase::optimize, program_nodes(v));
+}
+
+static int execute(std::vector<Fn::Ptr>& v, const interpreter_options& opts,
+                   const std::string& serve_at, const std::vector<std::string>& batch,
+                   const checkpointing& cp, const each_call& each, bool lazy, std::size_t specialize_nodes)
 {
-  if (argc != 1)
+  // the function called doesn't need to be reachable from `main`, nothing is inlined
+  if(!each.fn.empty())
+  {
+    passes::scope timed(passes::phase::run);
+    try
+    {
+      return run_each(v, opts, each) ? 0 : 1;
+    }
+    catch(const std::exception& e)
+    {
+      std::cerr << "error: " << e.what() << "\n";
+      return 1;
+    }
+  }
+  optimize(v, lazy, specialize_nodes);
+  if(!serve_at.empty())
   {
-    std::cerr << "insufficient arguments\n";
+    passes::scope timed(passes::phase::run);
+    return serve(serve_at, v, opts, std::cerr);
+  }
+  if(!batch.empty())
+  {
+    passes::scope timed(passes::phase::run);
+    return run_batch(batch, v, opts, std::cerr) == 0 ? 0 : 1;
+  }
+
+  auto run_opts = opts;
+  run_opts.checkpoint_path = cp.path;
+  run_opts.checkpoint_every = cp.every;
+  if(!cp.path.empty())
+    checkpoint::on_signal(SIGUSR2);
+  try
+  {
+    std::unique_ptr<session> sess;
+    {
+      passes::scope timed(passes::phase::prepare);
+      sess = std::make_unique<session>(v, run_opts);
+      if(passes::measuring())
+        passes::add_nodes(passes::phase::prepare, program_nodes(v));
+    }
+    passes::scope timed(passes::phase::run);
+    if(cp.resume_from.empty())
+      sess->run(std::cin, std::cout);
+    else if(!sess->resume(cp.resume_from, std::cin, std::cout, std::cerr))
+      return 1;
+    passes::add_nodes(passes::phase::run, sess->steps());
+  }
+  catch(const std::exception& e)
+  {
+    // exceeded limits, lazily parsed functions failing their checks and failed allocations
+    std::cerr << "error: " << e.what() << "\n";
     return 1;
   }
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  interpreter_options opts;
+  std::string compile_to;
+  std::string load_from;
+  std::vector<std::string> include_dirs;
+  std::string serve_at;
+  std::string connect_to;
+  std::vector<std::string> batch;
+  std::vector<std::string> programs;
+  std::size_t threads = 0;
+  std::size_t slice = 100000;
+  std::string trace_to;
+  std::size_t trace_events = 1 << 16;
+  checkpointing cp;
+  each_call each;
+  bool lazy = false;
+  std::size_t specialize_nodes = 4096;
+  // 0 doesn't report the phases, 1 as a table, 2 as JSON
+  int time_phases = 0;
+  for(int i = 1; i < argc; ++i)
+  {
+    const std::string_view arg = argv[i];
+    if(arg == "--threads" && i + 1 < argc)
+      thread_pool::set_threads(threads = std::stoul(argv[++i]));
+    else if(arg == "--memo-limit" && i + 1 < argc)
+      opts.memo_limit = std::stoull(argv[++i]);
+    else if(arg == "--memo-stats")
+      opts.memo_stats = true;
+    else if(arg == "--tier-calls" && i + 1 < argc)
+      opts.tier_calls = std::stoull(argv[++i]);
+    else if(arg == "--tier-iterations" && i + 1 < argc)
+      opts.tier_iterations = std::stoull(argv[++i]);
+    else if(arg == "--no-lockstep")
+      opts.lockstep = false;
+    else if(arg == "--each" && i + 2 < argc)
+    {
+      each.fn = argv[++i];
+      each.tuples = argv[++i];
+    }
+    else if(arg == "--tier-stats")
+      opts.tier_stats = true;
+    else if(arg == "--max-stack" && i + 1 < argc)
+      opts.max_stack_bytes = std::stoull(argv[++i]);
+    else if(arg == "--max-depth" && i + 1 < argc)
+      opts.max_call_depth = std::stoull(argv[++i]);
+    else if(arg == "--max-vars" && i + 1 < argc)
+      opts.max_vars = std::stoull(argv[++i]);
+    else if(arg == "--max-memory" && i + 1 < argc)
+      opts.max_memory = std::stoull(argv[++i]);
+    else if(arg == "--max-steps" && i + 1 < argc)
+      opts.max_steps = std::stoull(argv[++i]);
+    else if(arg == "--timeout" && i + 1 < argc)
+      opts.timeout = std::chrono::milliseconds(std::stoull(argv[++i]));
+    else if(arg == "--compile" && i + 1 < argc)
+      compile_to = argv[++i];
+    else if(arg == "--load" && i + 1 < argc)
+      load_from = argv[++i];
+    else if(arg == "--include" && i + 1 < argc)
+      include_dirs.emplace_back(argv[++i]);
+    else if(arg == "--specialize-nodes" && i + 1 < argc)
+      specialize_nodes = std::stoull(argv[++i]);
+    else if(arg == "--lazy")
+      lazy = true;
+    else if(arg == "--time-phases")
+    {
+      time_phases = 1;
+      if(i + 1 < argc && std::string_view(argv[i + 1]) == "json")
+        time_phases = 2, ++i;
+    }
+    else if(arg == "--disable-pass" && i + 1 < argc && passes::disable(argv[i + 1]))
+      ++i;
+    else if(arg == "--serve" && i + 1 < argc)
+      serve_at = argv[++i];
+    else if(arg == "--connect" && i + 1 < argc)
+      connect_to = argv[++i];
+    else if(arg == "--batch" && i + 1 < argc)
+    {
+      // every following argument up to the next option is an input
+      while(i + 1 < argc && std::string_view(argv[i + 1]).substr(0, 2) != "--")
+        batch.emplace_back(argv[++i]);
+    }
+    else if(arg == "--programs" && i + 1 < argc)
+    {
+      while(i + 1 < argc && std::string_view(argv[i + 1]).substr(0, 2) != "--")
+        programs.emplace_back(argv[++i]);
+    }
+    else if(arg == "--slice" && i + 1 < argc)
+      slice = std::stoull(argv[++i]);
+    else if(arg == "--trace" && i + 1 < argc)
+      trace_to = argv[++i];
+    else if(arg == "--trace-events" && i + 1 < argc)
+      trace_events = std::stoull(argv[++i]);
+    else if(arg == "--checkpoint" && i + 1 < argc)
+      cp.path = argv[++i];
+    else if(arg == "--checkpoint-every" && i + 1 < argc)
+      cp.every = std::chrono::milliseconds(std::stoull(argv[++i]));
+    else if(arg == "--resume" && i + 1 < argc)
+      cp.resume_from = argv[++i];
+    else
+    {
+      std::cerr << "unknown argument " << arg << "\n"
+                << "usage: " << argv[0] << " [--threads N] [--memo-limit BYTES] [--memo-stats] [--include DIR]... [--lazy]\n"
+                << "       [--tier-calls N] [--tier-iterations N] [--tier-stats] [--specialize-nodes N]\n"
+                << "       [--max-stack BYTES] [--max-depth N] [--max-vars N] [--max-memory BYTES]\n"
+                << "       [--max-steps N] [--timeout MS]\n"
+                << "       [--compile OUT.ralm | --serve SOCKET | --batch INPUT... | --each FN TUPLES [--no-lockstep]]\n"
+                << "       < program.ral | --load IN.ralm\n"
+                << "       --connect SOCKET < input\n"
+                << "       --programs PROGRAM.ral... [--slice STEPS]\n"
+                << "       [--trace FILE [--trace-events N]]\n"
+                << "       [--checkpoint FILE [--checkpoint-every MS]] [--resume FILE]\n"
+                << "       [--time-phases [json]] [--disable-pass verify|rename-swaps|inline|specialize]...\n";
+      return 1;
+    }
+  }
+
+  // a checkpoint is written by a forked copy of ral, which must not inherit threads
+  //  that may hold locks, so parallel code of a checkpointing run stays on this thread
+  if(!cp.path.empty())
+    thread_pool::set_threads(1);
+
+  // the trace is written on the way out, and whenever SIGUSR1 arrives
+  struct trace_writer
+  {
+    std::string path;
+    ~trace_writer()
+    {
+      if(!path.empty())
+        trace::dump(path, std::cerr);
+    }
+  } write_trace { trace_to };
+  if(!trace_to.empty())
+  {
+    trace::enable(trace_events);
+    trace::dump_on_signal(SIGUSR1, trace_to);
+  }
+
+  // the costs of the phases are reported on the way out as well
+  struct phase_report
+  {
+    int format;
+    ~phase_report()
+    {
+      if(format != 0)
+        passes::report(std::cerr, format == 2);
+    }
+  } report_phases { time_phases };
+  if(time_phases != 0)
+    passes::measure();
+
+  // many programs time-sliced over the threads, each writes to PROGRAM.out
+  if(!programs.empty())
+  {
+    scheduler sched(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency()), slice, opts);
+    for(auto& p : programs)
+    {
+      std::vector<Fn::Ptr> v;
+      if(!module_loader(include_dirs, lazy).load(p, v, std::cerr))
+        return 1;
+      optimize(v, lazy, specialize_nodes);
+      sched.add(p, std::move(v));
+    }
+    {
+      passes::scope timed(passes::phase::run);
+      sched.run();
+    }
+    sched.report(std::cerr);
+
+    bool ok = true;
+    for(auto& r : sched.results())
+    {
+      std::ofstream(r.name + ".out") << r.output;
+      ok = ok && r.error.empty();
+    }
+    return ok ? 0 : 1;
+  }
+
+  // the program lives in the server, stdin is its input
+  if(!connect_to.empty())
+    return request(connect_to, std::cin, std::cout, std::cerr);
+
+  // compiled modules are already checked, and leave stdin to the program
+  if(!load_from.empty())
+  {
+    auto v = load_module(load_from, std::cerr);
+    if(v.empty())
+      return 1;
+    return execute(v, opts, serve_at, batch, cp, each, false, specialize_nodes);
+  }
 
   std::string input;
   for(std::string str; std::getline(std::cin, str); input += str + "\n")
     ;
-  auto v = read_text(input);
 
-  for(auto& x : v)
-    infer(x.get());
-  interpret(std::cout, v);
+  // imports of the program are looked up relative to the working directory
+  std::vector<Fn::Ptr> v;
+  if(!module_loader(include_dirs, lazy).load_text(input, ".", v, std::cerr))
+    return 1;
 
-  return 0;
+  if(!compile_to.empty())
+  {
+    std::ofstream out(compile_to, std::ios::binary);
+    if(!write_module(out, v))
+    {
+      std::cerr << "error: cannot write " << compile_to << "\n";
+      return 1;
+    }
+    return 0;
+  }
+  return execute(v, opts, serve_at, batch, cp, each, lazy, specialize_nodes);
 }
-
-
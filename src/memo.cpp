@@ -0,0 +1,34 @@
+#include <memo.hpp>
+
+std::size_t memo_table::key_hasher::operator()(const Key& key) const
+{
+  std::size_t hash = key.size();
+  for(auto v : key)
+    hash ^= v + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+  return hash;
+}
+
+bool memo_table::lookup(const Key& args, bool uncall)
+{
+  if(seen[uncall].count(args))
+  {
+    hits++;
+    return true;
+  }
+  misses++;
+  return false;
+}
+
+void memo_table::insert(Key&& args, bool uncall)
+{
+  // rough size of a node in the hash set
+  const std::size_t size = sizeof(Key) + args.size() * sizeof(std::size_t) + 4 * sizeof(void*);
+  if(size > budget)
+    return;
+
+  if(seen[uncall].emplace(std::move(args)).second)
+  {
+    budget -= size;
+    bytes += size;
+  }
+}
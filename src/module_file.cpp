@@ -0,0 +1,566 @@
+#include <module_file.hpp>
+#include <analysis.hpp>
+#include <type.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <unordered_map>
+#include <type_traits>
+#include <ostream>
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+// Layout, all records are 8 byte aligned and native endian:
+//
+//  header
+//  symbol records   offset/length into the string blob
+//  type records     args are indices into the type index array
+//  node records     children are indices into the node index array
+//  fn records       params are (symbol, type) pairs in the param array
+//  index arrays and the string blob
+namespace
+{
+constexpr char module_magic[4] = { 'R', 'A', 'L', 'M' };
+constexpr std::uint32_t none = ~std::uint32_t(0);
+
+struct section
+{
+  std::uint64_t offset;
+  std::uint64_t count;
+};
+
+struct header
+{
+  char magic[4];
+  std::uint32_t version;
+
+  section symbols;
+  section types;
+  section nodes;
+  section fns;
+  section params;
+  section type_args;
+  section children;
+  section strings;
+};
+
+struct symbol_rec
+{
+  std::uint32_t offset;
+  std::uint32_t length;
+};
+
+struct type_rec
+{
+  std::uint32_t kind;
+  std::uint32_t args_begin;
+  std::uint32_t args_count;
+  std::uint32_t pad;
+  std::uint64_t length;
+};
+
+enum class data_kind : std::uint8_t
+{
+  None,
+  Num,
+  Object,
+  Cmp,
+  BinOp,
+  String,
+};
+
+struct node_rec
+{
+  std::uint16_t kind;
+  data_kind dkind;
+  std::uint8_t pad;
+  std::uint32_t typ;
+  std::uint32_t children_begin;
+  std::uint32_t children_count;
+  // literal, symbol or operator
+  std::uint64_t data;
+  // type of an object
+  std::uint32_t obj_typ;
+  std::uint32_t pad2;
+};
+
+struct param_rec
+{
+  std::uint32_t name;
+  std::uint32_t typ;
+};
+
+struct fn_rec
+{
+  std::uint32_t name;
+  std::uint32_t typ;
+  std::uint32_t params_begin;
+  std::uint32_t params_count;
+  std::uint32_t body;
+  std::uint32_t inv_body;
+  std::uint32_t pure;
+  std::uint32_t pad;
+};
+
+static_assert(std::is_trivially_copyable_v<node_rec> && sizeof(node_rec) % 8 == 0);
+static_assert(sizeof(type_rec) % 8 == 0 && sizeof(fn_rec) % 8 == 0 && sizeof(header) % 8 == 0);
+
+struct writer
+{
+  std::uint32_t intern(const std::string& str)
+  {
+    auto it = symbol_ids.find(str);
+    if(it != symbol_ids.end())
+      return it->second;
+
+    symbols.push_back({ static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(str.size()) });
+    strings += str;
+    return symbol_ids[str] = static_cast<std::uint32_t>(symbols.size() - 1);
+  }
+
+  std::uint32_t add(const Type::Ptr& typ)
+  {
+    if(!typ)
+      return none;
+
+    auto it = type_ids.find(typ.get());
+    if(it != type_ids.end())
+      return it->second;
+
+    std::vector<std::uint32_t> args;
+    for(auto& a : typ->args)
+      args.push_back(add(a));
+
+    type_rec rec { static_cast<std::uint32_t>(typ->kind), static_cast<std::uint32_t>(type_args.size()),
+                   static_cast<std::uint32_t>(args.size()), 0, typ->length };
+    type_args.insert(type_args.end(), args.begin(), args.end());
+    types.push_back(rec);
+    return type_ids[typ.get()] = static_cast<std::uint32_t>(types.size() - 1);
+  }
+
+  std::uint32_t add(const Node* n)
+  {
+    if(!n)
+      return none;
+
+    std::vector<std::uint32_t> kids;
+    for(auto& x : n->lhs)
+      kids.push_back(add(x.get()));
+
+    node_rec rec {};
+    rec.kind = static_cast<std::uint16_t>(n->kind);
+    rec.typ = add(n->typ);
+    rec.children_begin = static_cast<std::uint32_t>(children.size());
+    rec.children_count = static_cast<std::uint32_t>(kids.size());
+    rec.obj_typ = none;
+    std::visit([this, &rec](auto& d)
+    {
+      using T = std::decay_t<decltype(d)>;
+      if constexpr(std::is_same_v<T, std::size_t>)
+      { rec.dkind = data_kind::Num; rec.data = d; }
+      else if constexpr(std::is_same_v<T, Object>)
+      { rec.dkind = data_kind::Object; rec.data = intern(d.name); rec.obj_typ = add(d.type); }
+      else if constexpr(std::is_same_v<T, CmpTypes>)
+      { rec.dkind = data_kind::Cmp; rec.data = static_cast<std::uint64_t>(d); }
+      else if constexpr(std::is_same_v<T, BinOpTypes>)
+      { rec.dkind = data_kind::BinOp; rec.data = static_cast<std::uint64_t>(d); }
+      else if constexpr(std::is_same_v<T, std::string>)
+      { rec.dkind = data_kind::String; rec.data = intern(d); }
+      else
+        rec.dkind = data_kind::None;
+    }, n->data);
+
+    children.insert(children.end(), kids.begin(), kids.end());
+    nodes.push_back(rec);
+    return static_cast<std::uint32_t>(nodes.size() - 1);
+  }
+
+  std::unordered_map<std::string, std::uint32_t> symbol_ids;
+  std::unordered_map<const Type*, std::uint32_t> type_ids;
+
+  std::vector<symbol_rec> symbols;
+  std::vector<type_rec> types;
+  std::vector<node_rec> nodes;
+  std::vector<fn_rec> fns;
+  std::vector<param_rec> params;
+  std::vector<std::uint32_t> type_args;
+  std::vector<std::uint32_t> children;
+  std::string strings;
+};
+
+template<typename T>
+void emit(std::ostream& os, std::uint64_t& offset, section& sec, const T* data, std::size_t count)
+{
+  sec = { offset, count };
+
+  const std::size_t bytes = count * sizeof(T);
+  os.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+
+  // keep the next section aligned
+  static const char zeros[8] = {};
+  const std::size_t padding = (8 - bytes % 8) % 8;
+  os.write(zeros, static_cast<std::streamsize>(padding));
+  offset += bytes + padding;
+}
+
+// Keeps the file mapped as long as any function of it is alive.
+struct mapping
+{
+  mapping(const void* base, std::size_t size)
+    : base(static_cast<const char*>(base))
+    , size(size)
+  {  }
+
+  ~mapping()
+  { munmap(const_cast<char*>(base), size); }
+
+  template<typename T>
+  const T* at(const section& sec) const
+  { return reinterpret_cast<const T*>(base + sec.offset); }
+
+  const header& head() const
+  { return *reinterpret_cast<const header*>(base); }
+
+  std::string symbol(std::uint32_t id) const
+  {
+    auto& sym = at<symbol_rec>(head().symbols)[id];
+    return std::string(at<char>(head().strings) + sym.offset, sym.length);
+  }
+
+  Type::Ptr type(std::uint32_t id) const
+  { return id == none ? nullptr : types[id]; }
+
+  Node::Ptr node(std::uint32_t id) const
+  {
+    if(id == none)
+      return nullptr;
+
+    // `valid_ids` checked every id when the module was loaded
+    auto& rec = at<node_rec>(head().nodes)[id];
+    auto* kids = at<std::uint32_t>(head().children) + rec.children_begin;
+
+    std::vector<Node::Ptr> args;
+    args.reserve(rec.children_count);
+    for(std::uint32_t i = 0; i < rec.children_count; ++i)
+      args.emplace_back(node(kids[i]));
+
+    Node::Data data;
+    switch(rec.dkind)
+    {
+    case data_kind::None:   data = std::monostate {}; break;
+    case data_kind::Num:    data = static_cast<std::size_t>(rec.data); break;
+    case data_kind::Object: data = Object(symbol(static_cast<std::uint32_t>(rec.data)), type(rec.obj_typ)); break;
+    case data_kind::Cmp:    data = static_cast<CmpTypes>(rec.data); break;
+    case data_kind::BinOp:  data = static_cast<BinOpTypes>(rec.data); break;
+    case data_kind::String: data = symbol(static_cast<std::uint32_t>(rec.data)); break;
+    }
+
+    auto n = make_node(static_cast<NodeKind>(rec.kind), std::move(data), std::move(args));
+    n->typ = type(rec.typ);
+    return n;
+  }
+
+  const char* base;
+  std::size_t size;
+
+  std::vector<Type::Ptr> types;
+};
+
+bool section_fits(const section& sec, std::size_t elem, std::size_t size)
+{ return sec.offset <= size && sec.count <= (size - sec.offset) / elem; }
+
+bool range_fits(std::uint64_t begin, std::uint64_t count, const section& sec)
+{ return begin <= sec.count && count <= sec.count - begin; }
+
+// Types must have the arguments their kind expects, element types are integers.
+bool valid_shape(const type_rec& rec, const type_rec* types, const std::uint32_t* type_args)
+{
+  auto int_arg = [&](std::uint32_t a) { return is_int(static_cast<TypeKind>(types[type_args[rec.args_begin + a]].kind)); };
+  switch(static_cast<TypeKind>(rec.kind))
+  {
+  case TypeKind::Array:
+    return rec.args_count == 1 && int_arg(0);
+  case TypeKind::Stack:
+  case TypeKind::Queue:
+    return rec.args_count == 1 && int_arg(0) && rec.length == 0;
+  case TypeKind::Ptr:
+    return rec.args_count == 1 && rec.length == 0;
+  case TypeKind::Fn:
+    return rec.args_count >= 1 && rec.length == 0;
+  default:
+    return rec.args_count == 0 && rec.length == 0;
+  }
+}
+
+// Nodes must have the children and data the interpreter reads for their kind.
+bool valid_shape(const node_rec& rec, const node_rec* nodes, const std::uint32_t* children)
+{
+  auto kind_of = [&](std::uint32_t c) { return static_cast<NodeKind>(nodes[children[rec.children_begin + c]].kind); };
+  auto is_var = [&](std::uint32_t c) { return kind_of(c) == NodeKind::Var; };
+  auto is_lvalue = [&](std::uint32_t c) { return is_var(c) || kind_of(c) == NodeKind::Index; };
+  auto shaped = [&rec](std::uint32_t lo, std::uint32_t hi, std::initializer_list<data_kind> dkinds)
+  {
+    return rec.children_count >= lo && rec.children_count <= hi
+        && std::find(dkinds.begin(), dkinds.end(), rec.dkind) != dkinds.end();
+  };
+  constexpr auto any = ~std::uint32_t(0);
+
+  switch(static_cast<NodeKind>(rec.kind))
+  {
+  case NodeKind::Unit:        return shaped(0, 0, { data_kind::None });
+  case NodeKind::Num:         return shaped(0, 0, { data_kind::Num });
+  case NodeKind::Var:         return shaped(0, 0, { data_kind::Object });
+  case NodeKind::Index:       return shaped(2, 2, { data_kind::None }) && is_var(0);
+  case NodeKind::OpEq:        return shaped(2, 2, { data_kind::BinOp }) && is_lvalue(0);
+  case NodeKind::Cmp:         return shaped(2, 2, { data_kind::Cmp });
+  case NodeKind::Arith:       return shaped(2, 2, { data_kind::BinOp });
+  case NodeKind::Let:
+  case NodeKind::Unlet:       return shaped(2, 2, { data_kind::None, data_kind::Num }) && is_var(0);
+  case NodeKind::If:          return shaped(2, 4, { data_kind::None });
+  case NodeKind::DoYieldUndo: return shaped(2, 2, { data_kind::None });
+  case NodeKind::Block:       return shaped(0, any, { data_kind::None });
+  case NodeKind::Loop:        return shaped(3, 3, { data_kind::None });
+  case NodeKind::ParFor:      return shaped(4, 4, { data_kind::None }) && is_var(0);
+  case NodeKind::Swap:        return shaped(2, 2, { data_kind::None }) && is_lvalue(0) && is_lvalue(1);
+  case NodeKind::Call:
+  case NodeKind::Uncall:      return shaped(2, any, { data_kind::None }) && is_var(0) && is_var(1);
+  case NodeKind::Push:
+  case NodeKind::Pop:         return shaped(2, 2, { data_kind::Num }) && is_lvalue(0) && is_var(1);
+  case NodeKind::Size:
+  case NodeKind::Top:         return shaped(1, 1, { data_kind::None }) && is_var(0);
+  case NodeKind::Stmt:        return shaped(1, 1, { data_kind::None });
+  default:                    return false;
+  }
+}
+
+// Every id must point into its section, so a corrupt file is rejected instead of
+//  read out of bounds. Writing puts arguments and children before their users,
+//  which also rules out cycles.
+bool valid_ids(const mapping& map)
+{
+  auto& head = map.head();
+  auto sym_ok = [&head](std::uint64_t id) { return id < head.symbols.count; };
+  auto id_ok = [](std::uint32_t id, std::uint64_t below) { return id == none || id < below; };
+
+  auto* syms = map.at<symbol_rec>(head.symbols);
+  for(std::size_t i = 0; i < head.symbols.count; ++i)
+    if(!range_fits(syms[i].offset, syms[i].length, head.strings))
+      return false;
+
+  auto* types = map.at<type_rec>(head.types);
+  auto* type_args = map.at<std::uint32_t>(head.type_args);
+  for(std::size_t i = 0; i < head.types.count; ++i)
+  {
+    if(types[i].kind > static_cast<std::uint32_t>(TypeKind::Fn)
+    || !range_fits(types[i].args_begin, types[i].args_count, head.type_args))
+      return false;
+    for(std::uint32_t a = 0; a < types[i].args_count; ++a)
+      if(type_args[types[i].args_begin + a] >= i)
+        return false;
+    if(!valid_shape(types[i], types, type_args))
+      return false;
+  }
+
+  auto* nodes = map.at<node_rec>(head.nodes);
+  auto* children = map.at<std::uint32_t>(head.children);
+  for(std::size_t i = 0; i < head.nodes.count; ++i)
+  {
+    auto& rec = nodes[i];
+    if(rec.kind > static_cast<std::uint16_t>(NodeKind::Fn) || !id_ok(rec.typ, head.types.count)
+    || !range_fits(rec.children_begin, rec.children_count, head.children))
+      return false;
+    for(std::uint32_t c = 0; c < rec.children_count; ++c)
+      if(children[rec.children_begin + c] >= i)
+        return false;
+    if(!valid_shape(rec, nodes, children))
+      return false;
+
+    switch(rec.dkind)
+    {
+    case data_kind::None:
+    case data_kind::Num:
+      break;
+    case data_kind::Object:
+      if(!sym_ok(rec.data) || !id_ok(rec.obj_typ, head.types.count))
+        return false;
+      break;
+    case data_kind::Cmp:
+      if(rec.data > static_cast<std::uint64_t>(CmpTypes::Greater))
+        return false;
+      break;
+    case data_kind::BinOp:
+      if(rec.data > static_cast<std::uint64_t>(BinOpTypes::Div))
+        return false;
+      break;
+    case data_kind::String:
+      if(!sym_ok(rec.data))
+        return false;
+      break;
+    default:
+      return false;
+    }
+  }
+
+  auto* fns = map.at<fn_rec>(head.fns);
+  auto* params = map.at<param_rec>(head.params);
+  for(std::size_t i = 0; i < head.fns.count; ++i)
+  {
+    auto& rec = fns[i];
+    if(!sym_ok(rec.name) || !id_ok(rec.typ, head.types.count)
+    || rec.body >= head.nodes.count || !id_ok(rec.inv_body, head.nodes.count)
+    || !range_fits(rec.params_begin, rec.params_count, head.params))
+      return false;
+    for(std::uint32_t p = 0; p < rec.params_count; ++p)
+    {
+      auto typ = params[rec.params_begin + p].typ;
+      if(!sym_ok(params[rec.params_begin + p].name) || !id_ok(typ, head.types.count))
+        return false;
+
+      // memo tables key on integer arguments only
+      const auto kind = (typ == none ? TypeKind::Unit : static_cast<TypeKind>(types[typ].kind));
+      if(rec.pure && (kind == TypeKind::Array || kind == TypeKind::Stack || kind == TypeKind::Queue))
+        return false;
+    }
+  }
+  return true;
+}
+}
+
+bool write_module(std::ostream& os, const std::vector<Fn::Ptr>& fns)
+{
+  writer w;
+
+  auto pure = pure_functions(fns);
+  for(auto& f : fns)
+  {
+    f->load();
+    auto inv = (f->inv_body ? nullptr : invert(f->body.get()));
+
+    fn_rec rec {};
+    rec.name = w.intern(f->name);
+    rec.typ = w.add(f->typ);
+    rec.params_begin = static_cast<std::uint32_t>(w.params.size());
+    rec.params_count = static_cast<std::uint32_t>(f->params.size());
+    for(auto& p : f->params)
+      w.params.push_back({ w.intern(p.name), w.add(p.type) });
+    rec.body = w.add(f->body.get());
+    rec.inv_body = w.add(inv ? inv.get() : f->inv_body.get());
+    rec.pure = pure.count(f.get());
+
+    w.fns.push_back(rec);
+  }
+
+  header head {};
+  std::memcpy(head.magic, module_magic, sizeof(module_magic));
+  head.version = module_file_version;
+
+  // sections are written after the header, patch it in afterwards
+  std::uint64_t offset = sizeof(header);
+  const auto head_pos = os.tellp();
+  os.write(reinterpret_cast<const char*>(&head), sizeof(head));
+
+  emit(os, offset, head.symbols, w.symbols.data(), w.symbols.size());
+  emit(os, offset, head.types, w.types.data(), w.types.size());
+  emit(os, offset, head.nodes, w.nodes.data(), w.nodes.size());
+  emit(os, offset, head.fns, w.fns.data(), w.fns.size());
+  emit(os, offset, head.params, w.params.data(), w.params.size());
+  emit(os, offset, head.type_args, w.type_args.data(), w.type_args.size());
+  emit(os, offset, head.children, w.children.data(), w.children.size());
+  emit(os, offset, head.strings, w.strings.data(), w.strings.size());
+
+  os.seekp(head_pos);
+  os.write(reinterpret_cast<const char*>(&head), sizeof(head));
+  os.seekp(0, std::ios::end);
+  return static_cast<bool>(os);
+}
+
+std::vector<Fn::Ptr> load_module(const std::string& path, std::ostream& err)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    err << "error: cannot open module " << path << "\n";
+    return {};
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(header))
+  {
+    close(fd);
+    err << "error: " << path << " is not a ral module\n";
+    return {};
+  }
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED)
+  {
+    err << "error: cannot map module " << path << "\n";
+    return {};
+  }
+  auto map = std::make_shared<mapping>(base, size);
+  auto& head = map->head();
+
+  if(std::memcmp(head.magic, module_magic, sizeof(module_magic)) != 0)
+  {
+    err << "error: " << path << " is not a ral module\n";
+    return {};
+  }
+  if(head.version != module_file_version)
+  {
+    err << "error: " << path << " has version " << head.version
+        << ", expected " << module_file_version << ", recompile it\n";
+    return {};
+  }
+  if(!section_fits(head.symbols, sizeof(symbol_rec), size) || !section_fits(head.types, sizeof(type_rec), size)
+  || !section_fits(head.nodes, sizeof(node_rec), size) || !section_fits(head.fns, sizeof(fn_rec), size)
+  || !section_fits(head.params, sizeof(param_rec), size) || !section_fits(head.type_args, sizeof(std::uint32_t), size)
+  || !section_fits(head.children, sizeof(std::uint32_t), size) || !section_fits(head.strings, 1, size))
+  {
+    err << "error: " << path << " is truncated\n";
+    return {};
+  }
+  if(!valid_ids(*map))
+  {
+    err << "error: " << path << " is corrupt\n";
+    return {};
+  }
+
+  // types are few and shared between all bodies, so build them right away
+  auto* types = map->at<type_rec>(head.types);
+  auto* type_args = map->at<std::uint32_t>(head.type_args);
+  map->types.resize(head.types.count);
+  for(std::size_t i = 0; i < head.types.count; ++i)
+  {
+    // arguments are always written before the type using them
+    std::vector<Type::Ptr> args;
+    for(std::uint32_t a = 0; a < types[i].args_count; ++a)
+      args.emplace_back(map->types[type_args[types[i].args_begin + a]]);
+    map->types[i] = std::make_shared<Type>(static_cast<TypeKind>(types[i].kind), std::move(args), types[i].length);
+  }
+
+  std::vector<Fn::Ptr> fns;
+  auto* recs = map->at<fn_rec>(head.fns);
+  auto* params = map->at<param_rec>(head.params);
+  for(std::size_t i = 0; i < head.fns.count; ++i)
+  {
+    auto& rec = recs[i];
+
+    std::vector<Object> ps;
+    for(std::uint32_t p = 0; p < rec.params_count; ++p)
+      ps.emplace_back(map->symbol(params[rec.params_begin + p].name), map->type(params[rec.params_begin + p].typ));
+
+    auto f = std::make_unique<Fn>(map->symbol(rec.name), std::move(ps), map->type(rec.typ), nullptr);
+    f->pure = (rec.pure != 0);
+    f->loader = [map, body = rec.body, inv = rec.inv_body](Fn& fn)
+    {
+      fn.body = map->node(body);
+      fn.inv_body = map->node(inv);
+    };
+    fns.emplace_back(std::move(f));
+  }
+  return fns;
+}
@@ -0,0 +1,276 @@
+#include <module_loader.hpp>
+#include <thread_pool.hpp>
+#include <analysis.hpp>
+#include <optimize.hpp>
+#include <parser.hpp>
+#include <passes.hpp>
+#include <type.hpp>
+
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <set>
+
+namespace fs = std::filesystem;
+
+// FNV-1a, only used to notice that a cached file has changed
+static std::uint64_t content_hash(const std::string& text)
+{
+  std::uint64_t h = 14695981039346656037ull;
+  for(unsigned char c : text)
+    h = (h ^ c) * 1099511628211ull;
+  return h;
+}
+
+static bool slurp(const std::string& path, std::string& text)
+{
+  std::ifstream is(path, std::ios::binary);
+  if(!is)
+    return false;
+  std::stringstream ss;
+  ss << is.rdbuf();
+  text = ss.str();
+  return true;
+}
+
+std::shared_ptr<const checked_module> module_cache::find(const Key& key)
+{
+  std::lock_guard<std::mutex> lock(mut);
+  auto it = modules.find(key);
+  if(it == modules.end())
+  {
+    ++misses;
+    return nullptr;
+  }
+  ++hits;
+  return it->second;
+}
+
+void module_cache::insert(const Key& key, std::shared_ptr<const checked_module> mod)
+{
+  std::lock_guard<std::mutex> lock(mut);
+  modules.emplace(key, std::move(mod));
+}
+
+module_cache& module_cache::global()
+{
+  static module_cache cache;
+  return cache;
+}
+
+module_loader::module_loader(std::vector<std::string> search_path, bool lazy, module_cache& cache)
+  : search_path(std::move(search_path))
+  , lazy(lazy)
+  , cache(cache)
+{  }
+
+// A lazily parsed body is checked right after it is parsed. Whether a function is pure
+//  depends on its body, so these count as impure and aren't memoized.
+// The passes over a function after parsing it, each charged to its phase.
+static void count_nodes(passes::phase p, const Fn& f)
+{
+  if(passes::measuring())
+    passes::add_nodes(p, node_count(f.body.get()));
+}
+
+static void infer_fn(Fn& f)
+{
+  passes::scope timed(passes::phase::infer);
+  infer(&f);
+  count_nodes(passes::phase::infer, f);
+}
+
+static bool verify_fn(const Fn& f, std::ostream& err)
+{
+  if(!passes::enabled("verify"))
+    return true;
+  passes::scope timed(passes::phase::verify);
+  count_nodes(passes::phase::verify, f);
+  return verify(&f, err);
+}
+
+static void optimize_fn(Fn& f)
+{
+  if(!passes::enabled("rename-swaps"))
+    return;
+  passes::scope timed(passes::phase::optimize);
+  rename_swaps(f);
+  count_nodes(passes::phase::optimize, f);
+}
+
+static void check_on_load(Fn& f)
+{
+  f.pure = false;
+  f.loader = [parse = std::move(f.loader)](Fn& fn)
+  {
+    {
+      passes::scope timed(passes::phase::parse);
+      parse(fn);
+      count_nodes(passes::phase::parse, fn);
+    }
+    infer_fn(fn);
+
+    std::ostringstream err;
+    if(!verify_fn(fn, err))
+    {
+      // without the final newline, the message ends the same as any other
+      auto msg = err.str();
+      if(!msg.empty() && msg.back() == '\n')
+        msg.pop_back();
+      throw check_failed("`" + fn.name + "` fails its checks on its first call\n" + msg);
+    }
+    optimize_fn(fn);
+    fn.inv_body = invert(fn.body.get());
+  };
+}
+
+std::shared_ptr<const checked_module> module_loader::check(const std::string& path, const std::string& text)
+{
+  const module_cache::Key key { path, content_hash(text), lazy };
+  if(auto mod = cache.find(key))
+    return mod;
+
+  parsed_module parsed;
+  {
+    passes::scope timed(passes::phase::parse);
+    parsed = parse_module(text, path, lazy);
+    for(auto& f : parsed.fns)
+      count_nodes(passes::phase::parse, *f);
+  }
+
+  auto mod = std::make_shared<checked_module>();
+  mod->path = path;
+  mod->imports = std::move(parsed.imports);
+  mod->fns = std::move(parsed.fns);
+
+  std::ostringstream err;
+  for(auto& f : mod->fns)
+  {
+    if(f->loader)
+    {
+      check_on_load(*f);
+      continue;
+    }
+    infer_fn(*f);
+    mod->ok = verify_fn(*f, err) && mod->ok;
+  }
+  if(mod->ok)
+    for(auto& f : mod->fns)
+      if(!f->loader)
+        optimize_fn(*f);
+  mod->diagnostics = err.str();
+
+  cache.insert(key, mod);
+  return mod;
+}
+
+std::string module_loader::resolve(const std::string& import, const std::string& root) const
+{
+  std::string rel = import;
+  std::replace(rel.begin(), rel.end(), '.', '/');
+  rel += ".ral";
+
+  // the main module's directory comes first, then the search path in order
+  std::vector<fs::path> dirs { fs::path(root) };
+  for(auto& d : search_path)
+    dirs.emplace_back(d);
+
+  for(auto& d : dirs)
+  {
+    std::error_code ec;
+    auto p = d / rel;
+    if(fs::is_regular_file(p, ec))
+      return fs::weakly_canonical(p, ec).string();
+  }
+  return {};
+}
+
+bool module_loader::load(const std::string& path, std::vector<Fn::Ptr>& out, std::ostream& err)
+{
+  std::string text;
+  if(!slurp(path, text))
+  {
+    err << "error: cannot read " << path << "\n";
+    return false;
+  }
+  std::error_code ec;
+  auto canon = fs::weakly_canonical(path, ec);
+  return load_text(text, canon.parent_path().string(), out, err);
+}
+
+bool module_loader::load_text(const std::string& text, const std::string& dir, std::vector<Fn::Ptr>& out, std::ostream& err)
+{
+  bool ok = true;
+  std::vector<std::shared_ptr<const checked_module>> mods { check((fs::path(dir) / "<main>").string(), text) };
+  std::set<std::string> seen;
+
+  // breadth first over the import graph, one level at a time
+  for(std::size_t level = 0; level < mods.size(); )
+  {
+    std::vector<std::string> frontier;
+    for(std::size_t end = mods.size(); level < end; ++level)
+    {
+      for(auto& imp : mods[level]->imports)
+      {
+        auto path = resolve(imp, dir);
+        if(path.empty())
+        {
+          err << "error: cannot find module `" << imp << "`\n"
+              << "note: imported by " << mods[level]->path << "\n";
+          ok = false;
+        }
+        else if(seen.insert(path).second)
+          frontier.emplace_back(std::move(path));
+      }
+    }
+
+    std::vector<std::string> texts(frontier.size());
+    std::vector<std::shared_ptr<const checked_module>> next(frontier.size());
+    thread_pool::global().parallel_for(0, frontier.size(), 1, [&](std::size_t beg, std::size_t end)
+    {
+      for(std::size_t i = beg; i < end; ++i)
+        if(slurp(frontier[i], texts[i]))
+          next[i] = check(frontier[i], texts[i]);
+    });
+
+    for(std::size_t i = 0; i < frontier.size(); ++i)
+    {
+      if(next[i])
+        mods.emplace_back(std::move(next[i]));
+      else
+      {
+        err << "error: cannot read " << frontier[i] << "\n";
+        ok = false;
+      }
+    }
+  }
+  return link(std::move(mods), out, err) && ok;
+}
+
+bool module_loader::link(std::vector<std::shared_ptr<const checked_module>>&& mods, std::vector<Fn::Ptr>& out, std::ostream& err)
+{
+  bool ok = true;
+  std::map<std::string, const checked_module*> owner;
+  for(auto& mod : mods)
+  {
+    err << mod->diagnostics;
+    ok = ok && mod->ok;
+
+    for(auto& f : mod->fns)
+    {
+      auto [it, fresh] = owner.emplace(f->name, mod.get());
+      if(!fresh)
+      {
+        err << "error: function `" << f->name << "` is defined more than once\n"
+            << "note: in " << it->second->path << " and " << mod->path << "\n";
+        ok = false;
+        continue;
+      }
+      // cached modules are shared, the program gets its own copy
+      out.emplace_back(clone(*f));
+    }
+  }
+  return ok;
+}
@@ -0,0 +1,711 @@
+#include <int_kernels.hpp>
+#include <optimize.hpp>
+#include <analysis.hpp>
+#include <type.hpp>
+#include <ast.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <map>
+#include <set>
+
+// callees with a body of at most this cost are inlined, a loop is already too much
+static constexpr std::size_t inline_cost = 64;
+
+namespace
+{
+bool is_var_swap(const Node* n)
+{
+  return n->kind == NodeKind::Swap
+      && n->lhs[0]->kind == NodeKind::Var && n->lhs[1]->kind == NodeKind::Var;
+}
+
+const std::string& name_of(const Node* n)
+{ return std::get<Object>(n->data).name; }
+
+struct renamer
+{
+  // the variable holding the value of each name that moved
+  std::map<std::string, std::string> loc;
+
+  // a variable node of each moved name, to build the swaps putting values back
+  std::map<std::string, Node::Ptr> proto;
+
+  std::size_t removed { 0 };
+
+  const std::string& where(const std::string& x) const
+  {
+    auto it = loc.find(x);
+    return it == loc.end() ? x : it->second;
+  }
+
+  void swap(const Node* n)
+  {
+    auto& x = name_of(n->lhs[0].get());
+    auto& y = name_of(n->lhs[1].get());
+    for(auto* v : { n->lhs[0].get(), n->lhs[1].get() })
+      if(!proto.count(name_of(v)))
+        proto.emplace(name_of(v), clone(v));
+
+    auto lx = where(x);
+    auto ly = where(y);
+    loc[x] = ly;
+    loc[y] = lx;
+    for(auto* v : { &x, &y })
+      if(loc[*v] == *v)
+        loc.erase(*v);
+  }
+
+  Node::Ptr var(const std::string& name) const
+  {
+    auto v = clone(proto.at(name).get());
+    v->data = Object(name, std::get<Object>(v->data).type);
+    return v;
+  }
+
+  // emits the swaps that move every value back to its own variable
+  void settle(std::vector<Node::Ptr>& out)
+  {
+    while(!loc.empty())
+    {
+      auto [x, l] = *loc.begin();
+      out.emplace_back(make_node(NodeKind::Swap, var(x), var(l)));
+
+      // `l` now holds what `x` held before
+      loc.erase(x);
+      for(auto& [z, at] : loc)
+        if(at == x)
+        {
+          at = l;
+          if(z == l)
+            loc.erase(z);
+          break;
+        }
+    }
+  }
+
+  // whether `n` binds or unbinds a moved name or calls, which could see any variable
+  bool must_settle(const Node* n) const
+  {
+    switch(n->kind)
+    {
+    case NodeKind::Call:
+    case NodeKind::Uncall:
+      return true;
+
+    case NodeKind::Let:
+    case NodeKind::Unlet:
+    case NodeKind::ParFor:
+      if(loc.count(name_of(n->lhs[0].get())))
+        return true;
+      break;
+
+    default:
+      break;
+    }
+    for(auto& x : n->lhs)
+      if(x && must_settle(x.get()))
+        return true;
+    return false;
+  }
+
+  void rename(Node* n) const
+  {
+    if(!n)
+      return;
+    if(n->kind == NodeKind::Var)
+    {
+      auto it = loc.find(name_of(n));
+      if(it != loc.end())
+        n->data = Object(it->second, std::get<Object>(n->data).type);
+      return;
+    }
+    for(auto& x : n->lhs)
+      rename(x.get());
+  }
+};
+
+std::size_t visit(Node* n);
+
+std::size_t block(Node* b)
+{
+  // nested blocks are settled at their own end, so they look like any other statement
+  std::size_t removed = 0;
+  for(auto& st : b->lhs)
+    removed += visit(st.get());
+
+  renamer r;
+  std::vector<Node::Ptr> out;
+  for(auto& st : b->lhs)
+  {
+    if(is_var_swap(st.get()))
+    {
+      r.swap(st.get());
+      ++r.removed;
+      continue;
+    }
+    if(r.must_settle(st.get()))
+      r.settle(out);
+    r.rename(st.get());
+    out.emplace_back(std::move(st));
+  }
+  r.settle(out);
+
+  b->lhs = std::move(out);
+  return removed + r.removed;
+}
+
+std::size_t visit(Node* n)
+{
+  if(!n)
+    return 0;
+  if(n->kind == NodeKind::Block)
+    return block(n);
+
+  std::size_t removed = 0;
+  for(auto& x : n->lhs)
+    removed += visit(x.get());
+  return removed;
+}
+}
+
+std::size_t rename_swaps(Fn& f)
+{
+  // the inverse is built from the renamed body
+  assert(!f.inv_body && "Rename before building the inverse.");
+  return visit(f.body.get());
+}
+
+namespace
+{
+bool is_builtin(const std::string& name)
+{ return name == "print" || name == "read"; }
+
+struct inliner
+{
+  std::map<std::string, Fn*> fns;
+  std::set<const Fn*> recursive;
+  std::size_t inlined { 0 };
+
+  // who calls each function, and the names that may be bound where calls are expanded
+  std::map<const Fn*, std::vector<Fn*>> callers;
+  std::set<std::string> bound;
+
+  Fn* callee_of(const Node* call) const
+  {
+    auto it = fns.find(name_of(call->lhs[1].get()));
+    return it == fns.end() ? nullptr : it->second;
+  }
+
+  // functions `f` calls or uncalls, without the builtins
+  std::vector<Fn*> callees(Fn* f) const
+  {
+    f->load();
+    std::vector<Fn*> res;
+    for(auto& c : effects_of(f->body.get()).callees)
+      if(auto it = fns.find(c); it != fns.end())
+        res.emplace_back(it->second);
+    return res;
+  }
+
+  // depth first from `f`, callees come before their callers in `order`
+  void visit(Fn* f, std::set<Fn*>& seen, std::vector<Fn*>& order) const
+  {
+    if(!seen.insert(f).second)
+      return;
+    for(auto* g : callees(f))
+      visit(g, seen, order);
+    order.emplace_back(f);
+  }
+
+  // names bound by `f` or anything that may be running below it: parameters, lets and stores
+  std::set<std::string> bound_around(Fn* f) const
+  {
+    std::set<std::string> names;
+    std::set<const Fn*> seen;
+    std::vector<Fn*> todo { f };
+    while(!todo.empty())
+    {
+      auto* g = todo.back();
+      todo.pop_back();
+      if(!seen.insert(g).second)
+        continue;
+
+      for(auto& p : g->params)
+        names.insert(p.name);
+      auto eff = effects_of(g->body.get());
+      names.insert(eff.locals.begin(), eff.locals.end());
+      if(auto it = callers.find(g); it != callers.end())
+        todo.insert(todo.end(), it->second.begin(), it->second.end());
+    }
+    return names;
+  }
+
+  bool reaches_itself(Fn* f) const
+  {
+    std::set<Fn*> seen;
+    std::vector<Fn*> todo = callees(f);
+    while(!todo.empty())
+    {
+      auto* g = todo.back();
+      todo.pop_back();
+      if(g == f)
+        return true;
+      if(seen.insert(g).second)
+        for(auto* h : callees(g))
+          todo.emplace_back(h);
+    }
+    return false;
+  }
+
+  // The parameters are checked against the arguments again after the body, which
+  //  only sees the values they had before if the body can't change them.
+  bool can_inline(const Node* call, const Fn& callee) const
+  {
+    if(recursive.count(&callee) || callee.name == "main")
+      return false;
+    if(cost_of(callee.body.get()) > inline_cost)
+      return false;
+
+    // arrays, stacks and queues are passed by reference, a `let` would copy them
+    for(auto& p : callee.params)
+      if(is_array(p.type) || is_container(p.type))
+        return false;
+
+    auto eff = effects_of(callee.body.get());
+    bool calls = false;
+    for(auto& c : eff.callees)
+      calls = calls || !is_builtin(c);
+    for(std::size_t i = 2; i < call->lhs.size(); ++i)
+    {
+      auto* arg = call->lhs[i].get();
+      if(arg->kind == NodeKind::Num)
+        continue;
+      if(arg->kind != NodeKind::Var || calls)
+        return false;
+      if(eff.writes.count(name_of(arg)) || eff.locals.count(name_of(arg)))
+        return false;
+    }
+    return true;
+  }
+
+  // A parameter the body only reads is replaced by its argument, if that is a literal or
+  //  a variable of the same type. Nothing else could look it up, since the body calls nothing.
+  // If the name may be bound at the call, the call fails there, so the `let` is kept.
+  bool substitutable(const Object& p, const Node* arg, const effects& eff) const
+  {
+    if(eff.writes.count(p.name) || eff.locals.count(p.name) || bound.count(p.name))
+      return false;
+    for(auto& c : eff.callees)
+      if(!is_builtin(c))
+        return false;
+    if(arg->kind == NodeKind::Num)
+      return true;
+    return arg->typ && p.type && arg->typ->kind == p.type->kind;
+  }
+
+  static void substitute(Node::Ptr& n, const std::string& name, const Node* arg, const Type::Ptr& typ)
+  {
+    if(!n)
+      return;
+    if(n->kind == NodeKind::Var && name_of(n.get()) == name)
+    {
+      n = clone(arg);
+      n->typ = typ;
+      return;
+    }
+    for(auto& x : n->lhs)
+      substitute(x, name, arg, typ);
+  }
+
+  // `let r := f(e,*)` becomes  { let p := e;* S; unlet p := e;* let r := () },
+  //  an uncall runs the inverse of `S` instead. `r` is stored like a call does, see `is_store`.
+  Node::Ptr expand(const Node* call, const Fn& callee) const
+  {
+    auto param = [&](NodeKind kind, std::size_t i)
+    {
+      auto& p = callee.params[i];
+      auto id = make_node(NodeKind::Var, Object(p.name, p.type));
+      id->typ = p.type;
+      auto n = make_node(std::move(kind), std::move(id), clone(call->lhs[i + 2].get()));
+      n->typ = p.type;
+      return n;
+    };
+
+    auto body = (call->kind == NodeKind::Uncall
+                 ? (callee.inv_body ? clone(callee.inv_body.get()) : invert(callee.body.get()))
+                 : clone(callee.body.get()));
+    auto eff = effects_of(body.get());
+
+    std::vector<Node::Ptr> stmts;
+    std::vector<std::size_t> bound;
+    for(std::size_t i = 0; i < callee.params.size(); ++i)
+    {
+      auto& p = callee.params[i];
+      auto* arg = call->lhs[i + 2].get();
+      if(substitutable(p, arg, eff))
+        substitute(body, p.name, arg, p.type);
+      else
+      {
+        stmts.emplace_back(param(NodeKind::Let, i));
+        bound.emplace_back(i);
+      }
+    }
+    stmts.emplace_back(std::move(body));
+    for(auto i : bound)
+      stmts.emplace_back(param(NodeKind::Unlet, i));
+
+    auto store = clone(call->lhs[0].get());
+    auto unit = make_node(NodeKind::Unit, std::vector<Node::Ptr>{});
+    unit->typ = store->typ;
+    auto typ = store->typ;
+    std::vector<Node::Ptr> let;
+    let.emplace_back(std::move(store));
+    let.emplace_back(std::move(unit));
+    stmts.emplace_back(make_node(NodeKind::Let, Node::Data { std::size_t(1) }, std::move(let)));
+    stmts.back()->typ = typ;
+
+    return make_node(NodeKind::Block, std::move(stmts));
+  }
+
+  void rewrite(Node::Ptr& n)
+  {
+    if(!n)
+      return;
+    for(auto& x : n->lhs)
+      rewrite(x);
+
+    if(n->kind != NodeKind::Call && n->kind != NodeKind::Uncall)
+      return;
+    auto* callee = callee_of(n.get());
+    if(callee && can_inline(n.get(), *callee))
+    {
+      n = expand(n.get(), *callee);
+      ++inlined;
+    }
+  }
+};
+}
+
+std::size_t inline_calls(std::vector<std::unique_ptr<Fn>>& fns)
+{
+  inliner inl;
+  for(auto& f : fns)
+    inl.fns[f->name] = f.get();
+  auto main = inl.fns.find("main");
+  if(main == inl.fns.end())
+    return 0;
+
+  std::set<Fn*> seen;
+  std::vector<Fn*> order;
+  inl.visit(main->second, seen, order);
+
+  // unreachable functions are never loaded
+  fns.erase(std::remove_if(fns.begin(), fns.end(), [&](auto& f) { return !seen.count(f.get()); }), fns.end());
+  inl.fns.clear();
+  for(auto& f : fns)
+    inl.fns[f->name] = f.get();
+
+  for(auto* f : order)
+  {
+    if(inl.reaches_itself(f))
+      inl.recursive.insert(f);
+    for(auto* g : inl.callees(f))
+      inl.callers[g].emplace_back(f);
+  }
+
+  // callees are done before their callers, so inlined bodies are inlined already
+  for(auto* f : order)
+  {
+    const auto before = inl.inlined;
+    inl.bound = inl.bound_around(f);
+    inl.rewrite(f->body);
+    if(inl.inlined != before && (f->inv_body || f->loader))
+      f->inv_body = invert(f->body.get());
+  }
+  return inl.inlined;
+}
+
+namespace
+{
+bool is_num(const Node* n)
+{ return n->kind == NodeKind::Num; }
+
+Node::Ptr literal(std::size_t value, const Type::Ptr& typ)
+{
+  auto n = make_node(NodeKind::Num, Node::Data { value });
+  n->typ = typ;
+  return n;
+}
+
+Node::Ptr nothing()
+{ return make_node(NodeKind::Block, std::vector<Node::Ptr>{}); }
+
+// Replaces what only depends on literals by its result. A division by zero is kept,
+//  so that the run still fails where it would have.
+void fold(Node::Ptr& n)
+{
+  if(!n)
+    return;
+  for(auto& x : n->lhs)
+    fold(x);
+
+  switch(n->kind)
+  {
+  default:
+    return;
+
+  case NodeKind::Arith:
+  {
+    auto* a = n->lhs[0].get();
+    auto* b = n->lhs[1].get();
+    if(!is_num(a) || !is_num(b))
+      return;
+    auto op = std::get<BinOpTypes>(n->data);
+    auto& ops = int_ops_for(n->typ);
+    if(op == BinOpTypes::Div && ops.normalize(std::get<std::size_t>(b->data)) == 0)
+      return;
+    n = literal(ops.binop(op, std::get<std::size_t>(a->data), std::get<std::size_t>(b->data)), n->typ);
+    return;
+  }
+  case NodeKind::Cmp:
+  {
+    auto* a = n->lhs[0].get();
+    auto* b = n->lhs[1].get();
+    if(!is_num(a) || !is_num(b))
+      return;
+    auto& ops = int_ops_for(a->typ);
+    n = literal(ops.cmp(std::get<CmpTypes>(n->data), std::get<std::size_t>(a->data), std::get<std::size_t>(b->data)), n->typ);
+    return;
+  }
+  case NodeKind::If:
+  {
+    if(!is_num(n->lhs[0].get()))
+      return;
+    // the exit condition has to be checked unless it is known to agree
+    const bool taken = (std::get<std::size_t>(n->lhs[0]->data) != 0);
+    if(n->lhs.size() > 3 && (!is_num(n->lhs[3].get()) || (std::get<std::size_t>(n->lhs[3]->data) != 0) != taken))
+      return;
+    if(taken)
+      n = std::move(n->lhs[1]);
+    else
+      n = (n->lhs.size() > 2 ? std::move(n->lhs[2]) : nothing());
+    return;
+  }
+  case NodeKind::Loop:
+  {
+    // a loop that doesn't start is skipped, one that stops after the first run is its body
+    auto* from = n->lhs[0].get();
+    auto* until = n->lhs[2].get();
+    if(is_num(from) && std::get<std::size_t>(from->data) == 0)
+      n = nothing();
+    else if(is_num(from) && is_num(until) && std::get<std::size_t>(until->data) != 0)
+      n = std::move(n->lhs[1]);
+    return;
+  }
+  }
+}
+
+// reads of `name` become `value`, the callee of a call is no variable
+void substitute(Node::Ptr& n, const std::string& name, std::size_t value, const Type::Ptr& typ)
+{
+  if(!n)
+    return;
+  if(n->kind == NodeKind::Var && name_of(n.get()) == name)
+  {
+    n = literal(value, typ);
+    return;
+  }
+  const bool call = (n->kind == NodeKind::Call || n->kind == NodeKind::Uncall);
+  for(std::size_t i = 0; i < n->lhs.size(); ++i)
+    if(!call || i != 1)
+      substitute(n->lhs[i], name, value, typ);
+}
+
+struct specializer
+{
+  std::map<std::string, Fn*> fns;
+  std::vector<Fn::Ptr> made;
+  std::size_t budget;
+
+  // copies by their name
+  std::map<std::string, Fn*> copies;
+
+  // names each function and everything it calls write or bind
+  std::map<const Fn*, std::set<std::string>> touched_by;
+
+  Fn* callee_of(const Node* call) const
+  {
+    auto it = fns.find(name_of(call->lhs[1].get()));
+    return it == fns.end() ? nullptr : it->second;
+  }
+
+  const std::set<std::string>& touched(Fn* f)
+  {
+    if(auto it = touched_by.find(f); it != touched_by.end())
+      return it->second;
+
+    std::set<std::string> res;
+    std::set<Fn*> seen;
+    std::vector<Fn*> todo { f };
+    while(!todo.empty())
+    {
+      auto* g = todo.back();
+      todo.pop_back();
+      if(!seen.insert(g).second)
+        continue;
+      g->load();
+      auto eff = effects_of(g->body.get());
+      res.insert(eff.writes.begin(), eff.writes.end());
+      res.insert(eff.locals.begin(), eff.locals.end());
+      for(auto& c : eff.callees)
+        if(auto it = fns.find(c); it != fns.end())
+          todo.emplace_back(it->second);
+    }
+    return touched_by[f] = std::move(res);
+  }
+
+  // whether parameter `p` of `f` can be replaced by a literal in its body
+  bool fixable(Fn* f, const Object& p)
+  { return p.type && is_int(*p.type) && !touched(f).count(p.name); }
+
+  static void specialize(Fn& f, const Object& p, std::size_t value)
+  {
+    substitute(f.body, p.name, int_ops_for(p.type).normalize(value), p.type);
+  }
+
+  // the copy of `f` for the literals of `call`, if `f` has parameters to fix and the budget allows
+  Fn* copy_for(const Node* call, Fn* f)
+  {
+    if(f->name == "main")
+      return nullptr;
+
+    std::vector<std::size_t> fixed;
+    std::ostringstream name;
+    name << f->name << "{";
+    for(std::size_t i = 0; i < f->params.size(); ++i)
+    {
+      auto& p = f->params[i];
+      auto* arg = call->lhs[i + 2].get();
+      if(!is_num(arg) || !fixable(f, p))
+        continue;
+      name << (fixed.empty() ? "" : ",") << p.name << "=";
+      auto& ops = int_ops_for(p.type);
+      ops.print(name, ops.normalize(std::get<std::size_t>(arg->data)));
+      fixed.emplace_back(i);
+    }
+    name << "}";
+    if(fixed.empty())
+      return nullptr;
+    if(auto it = copies.find(name.str()); it != copies.end())
+      return it->second;
+
+    const auto cost = node_count(f->body.get());
+    if(cost > budget)
+      return nullptr;
+    budget -= cost;
+
+    auto copy = clone(*f);
+    copy->name = name.str();
+    // the inverse is built from the specialized body before the run
+    copy->inv_body = nullptr;
+    for(auto i : fixed)
+      specialize(*copy, f->params[i], std::get<std::size_t>(call->lhs[i + 2]->data));
+    fold(copy->body);
+
+    auto* res = copy.get();
+    copies.emplace(res->name, res);
+    made.emplace_back(std::move(copy));
+    return res;
+  }
+
+  // Points calls with literal arguments to copies. Returns whether anything changed.
+  bool rewrite(Node::Ptr& n)
+  {
+    if(!n)
+      return false;
+    bool changed = false;
+    for(auto& x : n->lhs)
+      changed = rewrite(x) || changed;
+
+    if(n->kind != NodeKind::Call && n->kind != NodeKind::Uncall)
+      return changed;
+    auto* callee = callee_of(n.get());
+    if(!callee || callee->params.size() + 2 != n->lhs.size())
+      return changed;
+    auto* copy = copy_for(n.get(), callee);
+    if(!copy)
+      return changed;
+
+    auto& id = n->lhs[1];
+    id->data = Object(copy->name, std::get<Object>(id->data).type);
+    return true;
+  }
+};
+}
+
+std::size_t specialize_calls(std::vector<std::unique_ptr<Fn>>& fns, std::size_t budget)
+{
+  specializer sp;
+  sp.budget = budget;
+  for(auto& f : fns)
+    sp.fns[f->name] = f.get();
+  auto main = sp.fns.find("main");
+  if(main == sp.fns.end() || budget == 0)
+    return 0;
+
+  // the run calls `main` with 0, unless the program calls it as well
+  auto* m = main->second;
+  bool called = false;
+  std::set<Fn*> reached;
+  std::vector<Fn*> todo { m };
+  while(!todo.empty())
+  {
+    auto* f = todo.back();
+    todo.pop_back();
+    if(!reached.insert(f).second)
+      continue;
+    f->load();
+    for(auto& c : effects_of(f->body.get()).callees)
+    {
+      called = called || c == "main";
+      if(auto it = sp.fns.find(c); it != sp.fns.end())
+        todo.emplace_back(it->second);
+    }
+  }
+  if(!called && m->params.size() == 1 && sp.fixable(m, m->params[0]))
+  {
+    sp.specialize(*m, m->params[0], 0);
+    fold(m->body);
+    if(m->inv_body)
+      m->inv_body = invert(m->body.get());
+  }
+
+  std::set<Fn*> seen;
+  todo = { m };
+  while(!todo.empty())
+  {
+    auto* f = todo.back();
+    todo.pop_back();
+    if(!seen.insert(f).second)
+      continue;
+
+    f->load();
+    if(sp.rewrite(f->body) && f->inv_body)
+      f->inv_body = invert(f->body.get());
+    for(auto& c : effects_of(f->body.get()).callees)
+    {
+      if(auto it = sp.copies.find(c); it != sp.copies.end())
+        todo.emplace_back(it->second);
+      else if(auto it = sp.fns.find(c); it != sp.fns.end())
+        todo.emplace_back(it->second);
+    }
+  }
+
+  const auto made = sp.made.size();
+  for(auto& f : sp.made)
+    fns.emplace_back(std::move(f));
+  return made;
+}
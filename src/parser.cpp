@@ -1,10 +1,13 @@
+#include <parser.hpp>
 #include <stream_lookup.hpp>
+#include <passes.hpp>
 #include <token.hpp>
 #include <type.hpp>
 #include <ast.hpp>
 
 #include <iostream>
 #include <sstream>
+#include <cstring>
 #include <set>
 
 auto token_precedence_map = tsl::robin_map<token_kind, int>( {
@@ -27,6 +30,7 @@ class parser
 {
   friend std::vector<Fn::Ptr> read(std::string_view module);
   friend std::vector<Fn::Ptr> read_text(const std::string& module);
+  friend parsed_module parse_module(const std::string& str, std::string_view name, bool lazy);
 public:
   static constexpr std::size_t lookahead_size = 4;
 
@@ -40,7 +44,8 @@ private:
     , is(stream_lookup[module])
     , linebuf()
     , col(0)
-    , row(1)
+    , file(source_map::add(module, file_id))
+    , line_offset(0)
     , uses_reader(true)
   {
     for(std::size_t i = 0; i < next_toks.size(); ++i)
@@ -50,12 +55,32 @@ private:
     consume(); 
   }
 
-  parser(std::istream& is)
+  parser(std::istream& is, std::string_view name = "#TXT#")
+    : module(name)
+    , is(is)
+    , linebuf()
+    , col(0)
+    , file(source_map::add(name, file_id))
+    , line_offset(0)
+    , uses_reader(false)
+  {
+    for(std::size_t i = 0; i < next_toks.size(); ++i)
+      consume();
+
+    // need one additional consume to initialize `current`
+    consume(); 
+  }
+
+  // Reads `is` as the part of the registered module `file_id` that starts at byte
+  //  `offset`, e.g. a function body parsed on first use, so locations stay the same.
+  parser(std::istream& is, std::uint32_t file_id, std::uint32_t offset)
     : module("#TXT#")
     , is(is)
     , linebuf()
     , col(0)
-    , row(1)
+    , file_id(file_id)
+    , file(nullptr)
+    , line_offset(offset)
     , uses_reader(false)
   {
     for(std::size_t i = 0; i < next_toks.size(); ++i)
@@ -66,7 +91,11 @@ private:
   }
 
   ~parser()
-  { if(uses_reader) stream_lookup.drop(module); }
+  {
+    if(uses_reader)
+      stream_lookup.drop(module, is);
+    passes::add_nodes(passes::phase::lex, tokens_read);
+  }
 
   token gett();
 
@@ -75,14 +104,17 @@ private:
   bool accept(char c);
   bool accept(token_kind c);
   void consume();
+  void skip_to(std::uint32_t offset);
 private:
   char getc();
+  bool next_line();
 private:
   // always uses old for the error
   Node::Ptr mk_error();
 
   Type::Ptr parse_type();
 
+  parsed_module parse_module();
   Fn::Ptr parse_fn();
 
   Node::Ptr parse_expr_stmt();
@@ -91,14 +123,19 @@ private:
   Node::Ptr parse_do_yield_undo();
   Node::Ptr parse_if();
   Node::Ptr parse_loop();
-  Node::Ptr parse_swap();
+  Node::Ptr parse_par();
+  Node::Ptr parse_swap(Node::Ptr&& lhs);
+  Node::Ptr parse_push_pop();
+  Node::Ptr parse_container_query();
 
   Node::Ptr parse_call();
   Node::Ptr parse_identifier();
+  Node::Ptr parse_lvalue();
   Node::Ptr parse_statement();
   Node::Ptr parse_prefix();
   Node::Ptr parse_expression(int precedence = 0);
   int precedence();
+  static int precedence(token_kind kind);
 
 private:
   std::string_view module;
@@ -107,7 +144,17 @@ private:
   std::string linebuf;
 
   std::size_t col;
-  std::size_t row;
+
+  // byte offset of `linebuf`, tokens only store their offset
+  std::uint32_t file_id;
+  // null if the lines of the module are known already
+  std::shared_ptr<source_file> file;
+  std::uint32_t line_offset;
+  bool started_lines { false };
+  std::size_t tokens_read { 0 };
+
+  // text of the module if function bodies are parsed on first use
+  std::shared_ptr<const std::string> source;
 
   token old;
   token current;
@@ -127,6 +174,16 @@ void parser::consume()
   next_toks.back() = gett();
 }
 
+// Drops the tokens read ahead and continues at byte `offset`, which must lie beyond them.
+void parser::skip_to(std::uint32_t offset)
+{
+  while(line_offset + linebuf.size() < offset && next_line())
+    ;
+  col = offset - line_offset;
+  for(std::size_t i = 0; i <= next_toks.size(); ++i)
+    consume();
+}
+
 bool parser::accept(char c)
 {
   if(current.kind != static_cast<token_kind>(c))
@@ -149,7 +206,7 @@ void parser::expect(char c)
 {
   if(current.kind != static_cast<token_kind>(c))
   {
-    std::cerr << "Expected " << c << " but got "
+    std::cerr << current.loc << ": Expected " << c << " but got "
               << kind_to_str(current.kind) << "\n";
     assert(false);
   }
@@ -160,7 +217,7 @@ void parser::expect(token_kind c)
 {
   if(current.kind != c)
   {
-    std::cerr << "Expected " << kind_to_str(c) << " but got "
+    std::cerr << current.loc << ": Expected " << kind_to_str(c) << " but got "
               << kind_to_str(current.kind) << "\n";
     assert(false);
   }
@@ -186,12 +243,38 @@ Type::Ptr parser::parse_type()
     expect(token_kind::RParen);
     return ty;
   }
+  // [ TYPE ; NUM ]
+  if(accept(token_kind::LBracket))
+  {
+    auto elem = parse_type();
+    expect(token_kind::Semi);
+    expect(token_kind::LiteralNumber);
+    const std::size_t length = std::stoull(old.data.str());
+    expect(token_kind::RBracket);
+
+    return array_type(std::move(elem), length);
+  }
   parse_identifier();
 
+  // stack<T> | queue<T> | stack | queue
+  if(old.data == "stack" || old.data == "queue")
+  {
+    auto kind = (old.data == "stack" ? TypeKind::Stack : TypeKind::Queue);
+    auto elem = int_type();
+    if(accept(token_kind::Less))
+    {
+      elem = parse_type();
+      expect(token_kind::Greater);
+    }
+    return container_type(kind, std::move(elem));
+  }
+
   auto ty = str2typ(old.data.str());
   if(!ty)
-    return nullptr;
-
+  {
+    std::cerr << old.loc << ": Unknown type " << old.data << "\n";
+    assert(false);
+  }
   return ty;
 }
 
@@ -230,6 +313,40 @@ Fn::Ptr parser::parse_fn()
   auto fn_typ = fn_type(std::move(par_typs), parse_type());
 
   expect(token_kind::DoubleColonEqual);
+
+  // A block body of a lazily parsed module is skipped without lexing it. Every brace
+  //  character is a token of its own, so matching them in the text finds its end.
+  if(source && current.kind == token_kind::LBrace)
+  {
+    const std::uint32_t beg = current.loc.offset;
+    std::uint32_t end = beg;
+    std::size_t depth = 0;
+    do
+    {
+      depth += ((*source)[end] == '{');
+      depth -= ((*source)[end] == '}');
+    } while(++end < source->size() && depth > 0);
+    if(depth > 0 || end <= next_toks.back().loc.offset)
+    {
+      // a short body, or an unmatched brace reported at the end of the text
+      while(current.loc.offset < end && current.kind != token_kind::EndOfFile)
+        consume();
+      if(depth > 0)
+        expect('}');
+    }
+    else
+      skip_to(end);
+
+    auto f = std::make_unique<Fn>(std::move(name), std::move(params), std::move(fn_typ), nullptr);
+    // the lines of the module are kept for the locations of the body
+    f->loader = [text = source, lines = file, id = file_id, beg, end](Fn& fn)
+    {
+      std::istringstream is(text->substr(beg, end - beg));
+      parser r(is, id, beg);
+      fn.body = r.parse_statement();
+    };
+    return f;
+  }
   auto body = parse_statement();
 
   return std::make_unique<Fn>(std::move(name), std::move(params), std::move(fn_typ), std::move(body));
@@ -244,6 +361,8 @@ Node::Ptr parser::parse_let(bool is_unlet)
 {
   consume();
   auto id = parse_identifier();
+  if(accept(token_kind::DoubleColon))
+    id->typ = parse_type();
   expect(token_kind::DoubleColonEqual);
   
   auto exp = parse_expression();
@@ -294,17 +413,84 @@ Node::Ptr parser::parse_loop()
   return make_node(NodeKind::Loop, std::move(cond), std::move(loop), std::move(cond2));
 }
 
-// IDENT <> IDENT
-Node::Ptr parser::parse_swap()
+// par IDENT from E₁ to E₂ do S
+Node::Ptr parser::parse_par()
 {
+  consume();
+  if(old.data != "par")
+    return mk_error();
+
   auto id = parse_identifier();
+  id->typ = int_type();
 
+  expect(token_kind::Keyword);
+  if(old.data != "from")
+    return mk_error();
+  auto beg = parse_expression();
+
+  expect(token_kind::Keyword);
+  if(old.data != "to")
+    return mk_error();
+  auto end = parse_expression();
+
+  expect(token_kind::Keyword);
+  if(old.data != "do")
+    return mk_error();
+  auto body = parse_statement();
+
+  std::vector<Node::Ptr> args;
+  args.emplace_back(std::move(id));
+  args.emplace_back(std::move(beg));
+  args.emplace_back(std::move(end));
+  args.emplace_back(std::move(body));
+  return make_node(NodeKind::ParFor, std::move(args));
+}
+
+// LVALUE <> LVALUE
+Node::Ptr parser::parse_swap(Node::Ptr&& id)
+{
   expect(token_kind::LessGreater);
 
-  auto e = parse_identifier();
+  auto e = parse_lvalue();
   return make_node(NodeKind::Swap, std::move(id), std::move(e));
 }
 
+// push ( LVALUE , IDENT ) | pop ( LVALUE , IDENT )
+Node::Ptr parser::parse_push_pop()
+{
+  consume();
+  const bool is_pop = (old.data == "pop");
+  expect(token_kind::LParen);
+  auto x = parse_lvalue();
+  expect(token_kind::Comma);
+  auto s = parse_identifier();
+  expect(token_kind::RParen);
+
+  std::vector<Node::Ptr> args;
+  args.emplace_back(std::move(x));
+  args.emplace_back(std::move(s));
+  return make_node(is_pop ? NodeKind::Pop : NodeKind::Push, Node::Data { std::size_t(is_pop) }, std::move(args));
+}
+
+// size ( IDENT ) | top ( IDENT ) | empty ( IDENT )
+Node::Ptr parser::parse_container_query()
+{
+  consume();
+  const auto what = old.data;
+  expect(token_kind::LParen);
+  auto s = parse_identifier();
+  expect(token_kind::RParen);
+
+  if(what == "top")
+    return make_node(NodeKind::Top, std::move(s));
+
+  auto size = make_node(NodeKind::Size, std::move(s));
+  if(what == "size")
+    return size;
+  // empty(s) is size(s) = 0
+  return make_node(NodeKind::Cmp, CmpTypes::Equal, std::move(size), make_node(NodeKind::Num, Node::Data { std::size_t(0) }));
+}
+
 Node::Ptr parser::parse_if()
 {
   consume();
@@ -370,24 +556,29 @@ Node::Ptr parser::parse_statement()
       return parse_if();
     else if(current.data == "from")
       return parse_loop();
+    else if(current.data == "par")
+      return parse_par();
     else
       return mk_error(); // TODO
   }
+  if(current.kind == token_kind::Identifier
+  && (current.data == "push" || current.data == "pop") && next_toks[0].kind == token_kind::LParen)
+    return parse_push_pop();
   if(current.kind == token_kind::Identifier)
   {
-    const auto parse_bin = [this](BinOpTypes typ)
+    auto lhs = parse_lvalue();
+    const auto parse_bin = [this,&lhs](BinOpTypes typ)
     {
-      auto lhs = parse_identifier();
       consume(); // <- already check'd
 
       auto rhs = parse_expression();
 
       return make_node(NodeKind::OpEq, std::move(typ), std::move(lhs), std::move(rhs));
     };
-    switch(next_toks[0].kind)
+    switch(current.kind)
     {
     default: return mk_error();
-    case token_kind::LessGreater:   return parse_swap();
+    case token_kind::LessGreater:   return parse_swap(std::move(lhs));
     case token_kind::PlusEqual:     return parse_bin(BinOpTypes::Add);
     case token_kind::MinusEqual:    return parse_bin(BinOpTypes::Sub);
     case token_kind::AsteriskEqual: return parse_bin(BinOpTypes::Mul);
@@ -424,6 +615,7 @@ Node::Ptr parser::parse_call()
       expect(token_kind::Comma);
     
     params.emplace_back(parse_expression());
+    first = false;
   }
   expect(token_kind::RParen);
   return make_node(is_reversed ? NodeKind::Uncall : NodeKind::Call, std::move(params));
@@ -442,6 +634,19 @@ Node::Ptr parser::parse_identifier()
   return make_node(NodeKind::Var, Node::Data { *it });
 }
 
+// IDENT | IDENT [ E ]
+Node::Ptr parser::parse_lvalue()
+{
+  auto id = parse_identifier();
+  if(!accept(token_kind::LBracket))
+    return id;
+
+  auto idx = parse_expression();
+  expect(token_kind::RBracket);
+
+  return make_node(NodeKind::Index, std::move(id), std::move(idx));
+}
+
 Node::Ptr parser::parse_prefix()
 {
   switch(current.kind)
@@ -450,7 +655,10 @@ Node::Ptr parser::parse_prefix()
 
   case token_kind::Identifier:
   {
-    return parse_identifier();
+    if((current.data == "size" || current.data == "top" || current.data == "empty")
+    && next_toks[0].kind == token_kind::LParen)
+      return parse_container_query();
+    return parse_lvalue();
   }
 
   case token_kind::LiteralNumber:
@@ -478,10 +686,16 @@ Node::Ptr parser::parse_expression(int prec)
   auto pref = parse_prefix();
   auto parse_cmp = [this,&pref](CmpTypes&& type) {
     consume();
-    auto right = parse_expression(token_precedence_map[old.kind]);
+    auto right = parse_expression(precedence(old.kind));
 
     pref = make_node(NodeKind::Cmp, std::move(type), std::move(pref), std::move(right));
   };
+  auto parse_arith = [this,&pref](BinOpTypes&& type) {
+    consume();
+    auto right = parse_expression(precedence(old.kind));
+
+    pref = make_node(NodeKind::Arith, std::move(type), std::move(pref), std::move(right));
+  };
 
   while(prec < precedence())
   {
@@ -491,6 +705,7 @@ Node::Ptr parser::parse_expression(int prec)
     case token_kind::Semi:
     case token_kind::RParen:
     case token_kind::RBrace:
+    case token_kind::RBracket:
       break;
 
     case token_kind::Less:             parse_cmp(CmpTypes::Less); break;
@@ -500,6 +715,11 @@ Node::Ptr parser::parse_expression(int prec)
     case token_kind::Greater:          parse_cmp(CmpTypes::Greater); break;
     case token_kind::GreaterEqual:     parse_cmp(CmpTypes::GreaterEqual); break;
 
+    case token_kind::Plus:             parse_arith(BinOpTypes::Add); break;
+    case token_kind::Minus:            parse_arith(BinOpTypes::Sub); break;
+    case token_kind::Asterisk:         parse_arith(BinOpTypes::Mul); break;
+    case token_kind::Slash:            parse_arith(BinOpTypes::Div); break;
+
     default:
       assert(false);
     }
@@ -515,7 +735,14 @@ int parser::precedence()
   token_kind prec = current.kind;
   if (prec == token_kind::Undef || prec == token_kind::EndOfFile || prec == token_kind::Semi)
     return 0;
-  return token_precedence_map[prec];
+  return precedence(prec);
+}
+
+int parser::precedence(token_kind kind)
+{
+  // no operator[], the table is shared by parsers running in parallel
+  auto it = token_precedence_map.find(kind);
+  return it != token_precedence_map.end() ? it->second : 0;
 }
 
 
@@ -536,6 +763,8 @@ auto operator_symbols_map = tsl::robin_map<std::string_view, token_kind>({
   {"="sv,  token_kind::Equal},
   {"("sv,  token_kind::LParen},
   {")"sv,  token_kind::RParen},
+  {"["sv,  token_kind::LBracket},
+  {"]"sv,  token_kind::RBracket},
   {"<>"sv, token_kind::LessGreater},
   {"<"sv,  token_kind::Less},
   {"<="sv, token_kind::LessEqual},
@@ -556,6 +785,9 @@ auto keyword_set = tsl::robin_set<std::string_view>({
   "else",
   "from",
   "until",
+  "par",
+  "to",
+  "import",
 });
 
 char parser::getc()
@@ -567,27 +799,15 @@ char parser::getc()
   {
     if(col >= linebuf.size())
     {
-      if(!linebuf.empty())
-        row++;
-      if(!(std::getline(is, linebuf)))
+      do
       {
-        col = 1;
-        linebuf = "";
-        return EOF;
-      }
-      else
-      {
-        while(linebuf.empty())
+        if(!next_line())
         {
-          row++;
-          if(!(std::getline(is, linebuf)))
-          {
-            col = 1;
-            linebuf = "";
-            return EOF;
-          }
+          col = 1;
+          linebuf = "";
+          return EOF;
         }
-      }
+      } while(linebuf.empty());
       col = 0;
     }
     ch = linebuf[col++];
@@ -610,15 +830,30 @@ char parser::getc()
 
   return ch;
 }
+
+bool parser::next_line()
+{
+  // lines are separated by a single '\n'
+  if(started_lines)
+    line_offset += static_cast<std::uint32_t>(linebuf.size() + 1);
+  started_lines = true;
+  if(!std::getline(is, linebuf))
+    return false;
+  if(file)
+    file->line_starts.push_back(line_offset);
+  return true;
+}
+
 token parser::gett()
 {
+  passes::scope timed(passes::phase::lex);
+  ++tokens_read;
 restart_get:
   symbol data("");
   token_kind kind = token_kind::Undef;
 
   char ch = getc();
-  std::size_t beg_row = row;
-  std::size_t beg_col = col - 1;
+  const source_loc loc { static_cast<std::uint32_t>(line_offset + col - 1), file_id };
 
   bool starts_with_zero = false;
   switch(ch)
@@ -637,10 +872,11 @@ restart_get:
         // we look up in the operator map only for the single char. otherwise we wont parse y:= not correctly for example
         std::string ch_s;
         ch_s.push_back(ch);
-        // break if we hit whitespace (or other control chars) or any other operator symbol char
+        // break if we hit whitespace (or other control chars), any other operator symbol char or punctuation.
+        // Don't stop at keyword prefixes, otherwise `total` would be lexed as `to` `tal`
         if(std::iscntrl(ch) || std::isspace(ch)
         || operator_symbols_map.contains(ch_s.c_str())
-        || keyword_set.contains(name.c_str()))
+        || std::strchr("{}(),:~", ch))
         {
           col--;
           break;
@@ -680,7 +916,7 @@ restart_get:
         std::string ch_s;
         ch_s.push_back(ch);
         // break if we hit whitespace (or other control chars) or any other token char
-        if(std::iscntrl(ch) || std::isspace(ch) || operator_symbols_map.count(ch_s.c_str()) || keyword_set.count(name.c_str()))
+        if(std::iscntrl(ch) || std::isspace(ch) || operator_symbols_map.count(ch_s.c_str()) || std::strchr("{}(),:~", ch))
         {
           col--;
           break;
@@ -853,6 +1089,16 @@ restart_get:
     kind = token_kind::RBrace;
     data = "}";
   } break;
+  case '[':
+  {
+    kind = token_kind::LBracket;
+    data = "[";
+  } break;
+  case ']':
+  {
+    kind = token_kind::RBracket;
+    data = "]";
+  } break;
   case '(':
   {
     kind = token_kind::LParen;
@@ -868,22 +1114,36 @@ restart_get:
       data = "EOF";
     break;
   }
-  return token(kind, data, {module, beg_col + 1, beg_row, col + 1, row + 1});
+  return token(kind, data, loc);
 }
 
-std::vector<Fn::Ptr> read(std::string_view module)
+parsed_module parser::parse_module()
 {
-  parser r(module);
-
-  std::vector<Fn::Ptr> stmts;
-  while(r.current.kind != token_kind::EndOfFile)
+  parsed_module mod;
+  while(current.kind != token_kind::EndOfFile)
   {
-    auto stmt = r.parse_fn();
+    // import IDENT ;?
+    if(current.kind == token_kind::Keyword && current.data == "import")
+    {
+      consume();
+      parse_identifier();
+      mod.imports.emplace_back(old.data.str());
+      accept(token_kind::Semi);
+      continue;
+    }
+    auto stmt = parse_fn();
 
-    stmts.emplace_back(std::move(stmt));
+    mod.fns.emplace_back(std::move(stmt));
   }
+  return mod;
+}
 
-  return stmts;
+std::vector<Fn::Ptr> read(std::string_view module)
+{
+  parser r(module);
+
+  // imports are resolved by the module_loader
+  return r.parse_module().fns;
 }
 
 std::vector<Fn::Ptr> read_text(const std::string& str)
@@ -891,14 +1151,15 @@ std::vector<Fn::Ptr> read_text(const std::string& str)
   std::stringstream ss(str);
   parser r(ss);
 
-  std::vector<Fn::Ptr> stmts;
-  while(r.current.kind != token_kind::EndOfFile)
-  {
-    auto stmt = r.parse_fn();
+  return r.parse_module().fns;
+}
 
-    stmts.emplace_back(std::move(stmt));
-  }
+parsed_module parse_module(const std::string& str, std::string_view name, bool lazy)
+{
+  std::stringstream ss(str);
+  parser r(ss, name);
+  if(lazy)
+    r.source = std::make_shared<const std::string>(str);
 
-  return stmts;
+  return r.parse_module();
 }
-
@@ -0,0 +1,168 @@
+#include <passes.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <array>
+#include <mutex>
+#include <set>
+
+namespace passes
+{
+struct phase_stats
+{
+  std::atomic<std::uint64_t> nanoseconds { 0 };
+  std::atomic<std::uint64_t> allocations { 0 };
+  std::atomic<std::uint64_t> bytes { 0 };
+  std::atomic<std::uint64_t> nodes { 0 };
+};
+
+static std::atomic<bool> on { false };
+static std::array<phase_stats, phase_count> stats;
+
+static std::mutex disabled_mutex;
+static std::set<std::string_view> disabled;
+
+static constexpr std::string_view optional_passes[] = { "verify", "rename-swaps", "inline", "specialize" };
+
+// Innermost scope of the calling thread, and what its scopes charged so far. Lexing
+//  opens a scope per token, so charges only reach `stats` when the outermost one ends.
+struct pending_stats
+{
+  std::uint64_t nanoseconds { 0 };
+  std::uint64_t allocations { 0 };
+  std::uint64_t bytes { 0 };
+};
+static thread_local scope* innermost = nullptr;
+static thread_local std::array<pending_stats, phase_count> pending;
+
+std::string_view name(phase p)
+{
+  switch(p)
+  {
+  case phase::lex:      return "lex";
+  case phase::parse:    return "parse";
+  case phase::infer:    return "infer";
+  case phase::verify:   return "verify";
+  case phase::optimize: return "optimize";
+  case phase::prepare:  return "prepare";
+  case phase::run:      return "run";
+  }
+  return "unknown";
+}
+
+bool disable(std::string_view pass)
+{
+  for(auto known : optional_passes)
+    if(known == pass)
+    {
+      std::lock_guard<std::mutex> lock(disabled_mutex);
+      disabled.insert(known);
+      return true;
+    }
+  return false;
+}
+
+bool enabled(std::string_view pass)
+{
+  std::lock_guard<std::mutex> lock(disabled_mutex);
+  return disabled.count(pass) == 0;
+}
+
+void measure()
+{
+  on = true;
+}
+
+bool measuring()
+{
+  return on.load(std::memory_order_relaxed);
+}
+
+scope::scope(phase p)
+  : p(p)
+  , active(measuring())
+{
+  if(!active)
+    return;
+  outer = innermost;
+  if(outer)
+    outer->charge();
+  innermost = this;
+  since = std::chrono::steady_clock::now();
+  at = allocated;
+}
+
+scope::~scope()
+{
+  if(!active)
+    return;
+  charge();
+  innermost = outer;
+  if(outer)
+  {
+    outer->since = std::chrono::steady_clock::now();
+    outer->at = allocated;
+    return;
+  }
+  for(std::size_t i = 0; i < phase_count; ++i)
+  {
+    stats[i].nanoseconds += pending[i].nanoseconds;
+    stats[i].allocations += pending[i].allocations;
+    stats[i].bytes += pending[i].bytes;
+    pending[i] = {};
+  }
+}
+
+void scope::charge()
+{
+  auto& s = pending[static_cast<std::size_t>(p)];
+  auto now = std::chrono::steady_clock::now();
+  s.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(now - since).count();
+  s.allocations += allocated.allocations - at.allocations;
+  s.bytes += allocated.bytes - at.bytes;
+}
+
+void add_nodes(phase p, std::size_t n)
+{
+  stats[static_cast<std::size_t>(p)].nodes += n;
+}
+
+void report(std::ostream& os, bool json)
+{
+  if(json)
+  {
+    os << "{\"phases\": [";
+    for(std::size_t i = 0; i < phase_count; ++i)
+    {
+      auto& s = stats[i];
+      os << (i ? ", " : "") << "{\"phase\": \"" << name(static_cast<phase>(i)) << "\", "
+         << "\"wall_ns\": " << s.nanoseconds << ", \"allocations\": " << s.allocations << ", "
+         << "\"bytes\": " << s.bytes << ", \"nodes\": " << s.nodes << "}";
+    }
+    os << "], \"disabled\": [";
+    std::lock_guard<std::mutex> lock(disabled_mutex);
+    bool first = true;
+    for(auto pass : disabled)
+    {
+      os << (first ? "" : ", ") << "\"" << pass << "\"";
+      first = false;
+    }
+    os << "]}\n";
+    return;
+  }
+
+  os << std::left << std::setw(10) << "phase" << std::right << std::setw(12) << "wall ms"
+     << std::setw(14) << "allocations" << std::setw(14) << "bytes" << std::setw(14) << "nodes" << "\n";
+  for(std::size_t i = 0; i < phase_count; ++i)
+  {
+    auto& s = stats[i];
+    os << std::left << std::setw(10) << name(static_cast<phase>(i)) << std::right
+       << std::setw(12) << std::fixed << std::setprecision(2) << s.nanoseconds / 1e6
+       << std::setw(14) << s.allocations << std::setw(14) << s.bytes << std::setw(14) << s.nodes << "\n";
+  }
+  std::lock_guard<std::mutex> lock(disabled_mutex);
+  for(auto pass : disabled)
+    os << "disabled: " << pass << "\n";
+}
+}
@@ -0,0 +1,126 @@
+#include <embed.hpp>
+#include <ral.h>
+
+#include <exception>
+#include <sstream>
+#include <memory>
+#include <string>
+
+static thread_local std::string last_error;
+
+struct ral_program
+{
+  embedded_program prog;
+
+  // the arguments in the layout of `host_arg`, kept to not allocate per call
+  std::vector<host_arg> args;
+};
+
+static std::vector<std::string> dirs(const char* const* search_path, size_t n)
+{
+  return std::vector<std::string>(search_path, search_path + n);
+}
+
+template<typename Load>
+static ral_program* load(const char* const* search_path, size_t n, Load&& load)
+{
+  // nothing may unwind into the host
+  try
+  {
+    std::unique_ptr<ral_program> p(new ral_program { embedded_program(dirs(search_path, n)), {} });
+    std::ostringstream err;
+    if(load(p->prog, err))
+      return p.release();
+    last_error = err.str();
+  }
+  catch(const std::exception& e)
+  {
+    last_error = e.what();
+  }
+  catch(...)
+  {
+    last_error = "unknown error";
+  }
+  return nullptr;
+}
+
+ral_program* ral_load(const char* path, const char* const* search_path, size_t n)
+{
+  return load(search_path, n, [path](embedded_program& prog, std::ostream& err)
+    { return prog.load(path, err); });
+}
+
+ral_program* ral_load_text(const char* text, const char* const* search_path, size_t n)
+{
+  return load(search_path, n, [text](embedded_program& prog, std::ostream& err)
+    { return prog.load_text(text, err); });
+}
+
+void ral_free(ral_program* p)
+{
+  delete p;
+}
+
+ral_function* ral_find(ral_program* p, const char* name)
+{
+  return reinterpret_cast<ral_function*>(p->prog.find(name));
+}
+
+// `n` arguments, or `count` tuples of them with `each`
+static int invoke(ral_program* p, ral_function* f, const ral_arg* args, size_t n, bool uncall, bool each = false)
+{
+  auto* fn = reinterpret_cast<Fn*>(f);
+  const size_t total = (each && fn ? n * fn->params.size() : n);
+
+  // nothing may unwind into the host: limits, failing runs, bodies failing their checks
+  //  when first loaded, running out of memory
+  try
+  {
+    p->args.resize(total);
+    for(size_t i = 0; i < total; ++i)
+      p->args[i] = host_arg { args[i].value, args[i].data, args[i].length };
+
+    bool ok = false;
+    if(each)
+      ok = (uncall ? p->prog.uncall_each(fn, p->args.data(), n) : p->prog.call_each(fn, p->args.data(), n));
+    else
+      ok = (uncall ? p->prog.uncall(fn, p->args.data(), n) : p->prog.call(fn, p->args.data(), n));
+    if(ok)
+      return 0;
+    last_error = "arguments don't match the parameters";
+  }
+  catch(const std::exception& e)
+  {
+    last_error = e.what();
+  }
+  catch(...)
+  {
+    last_error = "unknown error";
+  }
+  return -1;
+}
+
+int ral_call(ral_program* p, ral_function* f, const ral_arg* args, size_t n)
+{
+  return invoke(p, f, args, n, false);
+}
+
+int ral_uncall(ral_program* p, ral_function* f, const ral_arg* args, size_t n)
+{
+  return invoke(p, f, args, n, true);
+}
+
+int ral_call_each(ral_program* p, ral_function* f, const ral_arg* args, size_t count)
+{
+  return invoke(p, f, args, count, false, true);
+}
+
+int ral_uncall_each(ral_program* p, ral_function* f, const ral_arg* args, size_t count)
+{
+  return invoke(p, f, args, count, true, true);
+}
+
+const char* ral_error(void)
+{
+  return last_error.c_str();
+}
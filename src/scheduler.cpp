@@ -0,0 +1,150 @@
+#include <scheduler.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+struct scheduler::program
+{
+  program(std::string name, std::vector<Fn::Ptr>&& fns, std::string input,
+          std::size_t slice, const interpreter_options& opts)
+    : fns(std::move(fns))
+    , sess(this->fns, opts)
+    , input(std::move(input))
+    , run([this, slice](fiber& self)
+      {
+        // suspending hands the thread back to the scheduler, it resumes us with a new slice
+        sess.run(this->input, output, slice, [&self, slice]() { self.suspend(); return slice; });
+      })
+  { st.name = std::move(name); }
+
+  std::vector<Fn::Ptr> fns;
+  session sess;
+
+  std::istringstream input;
+  std::ostringstream output;
+  fiber run;
+
+  // The worker that first ran it, it only ever resumes there. Trace rings, optimizer
+  //  passes and the work queues of parallel code keep per thread state the fiber
+  //  holds on to across slices.
+  std::size_t home { no_home };
+  static constexpr std::size_t no_home = ~std::size_t(0);
+
+  stats st;
+  clock::time_point queued;
+  clock::time_point started;
+};
+
+scheduler::scheduler(std::size_t threads, std::size_t slice, const interpreter_options& opts)
+  : threads(std::max<std::size_t>(threads, 1))
+  , slice(std::max<std::size_t>(slice, 1))
+  , opts(opts)
+{  }
+
+scheduler::~scheduler() = default;
+
+void scheduler::add(std::string name, std::vector<Fn::Ptr>&& fns, std::string input)
+{
+  programs.emplace_back(std::make_unique<program>(std::move(name), std::move(fns), std::move(input), slice, opts));
+
+  auto* p = programs.back().get();
+  p->started = p->queued = clock::now();
+  std::lock_guard<std::mutex> lock(mut);
+  ready.push_back(p);
+}
+
+void scheduler::work(std::size_t self)
+{
+  for(;;)
+  {
+    program* p = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mut);
+      // the first program queued that is new or started here
+      auto mine = ready.end();
+      ready_cv.wait(lock, [this, self, &mine]()
+      {
+        mine = std::find_if(ready.begin(), ready.end(), [self](program* q)
+        { return q->home == program::no_home || q->home == self; });
+        // done once nothing is queued and nobody could queue anything again
+        return mine != ready.end() || (ready.empty() && running == 0);
+      });
+      if(mine == ready.end())
+        return;
+      p = *mine;
+      ready.erase(mine);
+      p->home = self;
+      ++running;
+    }
+
+    auto beg = clock::now();
+    p->st.max_wait = std::max(p->st.max_wait, beg - p->queued);
+
+    bool done = true;
+    try
+    {
+      done = p->run.resume();
+    }
+    catch(const std::exception& e)
+    {
+      p->st.error = e.what();
+    }
+
+    auto end = clock::now();
+    p->st.slices++;
+    p->st.busy += end - beg;
+    p->st.max_slice = std::max(p->st.max_slice, end - beg);
+    p->queued = end;
+
+    std::lock_guard<std::mutex> lock(mut);
+    --running;
+    if(done)
+    {
+      p->st.steps = p->sess.steps();
+      p->st.total = end - p->started;
+      p->st.output = p->output.str();
+    }
+    else
+      ready.push_back(p);
+    ready_cv.notify_all();
+  }
+}
+
+void scheduler::run()
+{
+  std::vector<std::thread> workers;
+  for(std::size_t i = 0; i < threads; ++i)
+    workers.emplace_back([this, i]() { work(i); });
+  for(auto& w : workers)
+    w.join();
+
+  finished.clear();
+  for(auto& p : programs)
+    finished.emplace_back(std::move(p->st));
+  programs.clear();
+}
+
+const std::vector<scheduler::stats>& scheduler::results() const
+{
+  return finished;
+}
+
+void scheduler::report(std::ostream& os) const
+{
+  using ms = std::chrono::duration<double, std::milli>;
+
+  os << std::left << std::setw(24) << "program" << std::right
+     << std::setw(8) << "slices" << std::setw(12) << "steps"
+     << std::setw(11) << "busy[ms]" << std::setw(11) << "total[ms]"
+     << std::setw(15) << "max slice[ms]" << std::setw(14) << "max wait[ms]" << "\n";
+  os << std::fixed << std::setprecision(2);
+  for(auto& s : finished)
+    os << std::left << std::setw(24) << s.name << std::right
+       << std::setw(8) << s.slices << std::setw(12) << s.steps
+       << std::setw(11) << ms(s.busy).count() << std::setw(11) << ms(s.total).count()
+       << std::setw(15) << ms(s.max_slice).count() << std::setw(14) << ms(s.max_wait).count()
+       << (s.error.empty() ? "" : "  error: " + s.error) << "\n";
+}
@@ -0,0 +1,160 @@
+#include <server.hpp>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+
+// A client idle for this long while sending its input or taking the output is dropped,
+//  so that one that never shuts down its side can't hold up the others.
+static constexpr timeval client_timeout { 10, 0 };
+
+static bool make_address(const std::string& path, sockaddr_un& addr, std::ostream& err)
+{
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(path.size() >= sizeof(addr.sun_path))
+  {
+    err << "error: socket path " << path << " is too long\n";
+    return false;
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+static bool read_all(int fd, std::string& out)
+{
+  char buf[64 * 1024];
+  for(;;)
+  {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if(n == 0)
+      return true;
+    if(n < 0 && errno != EINTR)
+      return false;
+    if(n > 0)
+      out.append(buf, n);
+  }
+}
+
+static bool write_all(int fd, const std::string& in)
+{
+  for(std::size_t done = 0; done < in.size(); )
+  {
+    ssize_t n = write(fd, in.data() + done, in.size() - done);
+    if(n < 0 && errno != EINTR)
+      return false;
+    if(n > 0)
+      done += n;
+  }
+  return true;
+}
+
+int serve(const std::string& path, const std::vector<Fn::Ptr>& fns,
+          const interpreter_options& opts, std::ostream& err)
+{
+  sockaddr_un addr;
+  if(!make_address(path, addr, err))
+    return 1;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path.c_str());
+  if(fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0)
+  {
+    err << "error: cannot listen on " << path << ": " << std::strerror(errno) << "\n";
+    if(fd >= 0)
+      close(fd);
+    return 1;
+  }
+
+  // a client going away must not take the server with it
+  std::signal(SIGPIPE, SIG_IGN);
+
+  // everything up to the first run happens exactly once
+  session sess(fns, opts);
+  std::string input;
+  std::ostringstream output;
+  for(;;)
+  {
+    int conn = accept(fd, nullptr, nullptr);
+    if(conn < 0)
+    {
+      if(errno == EINTR)
+        continue;
+      err << "error: accept failed: " << std::strerror(errno) << "\n";
+      break;
+    }
+
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &client_timeout, sizeof(client_timeout));
+    setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &client_timeout, sizeof(client_timeout));
+
+    input.clear();
+    output.str({});
+    output.clear();
+    if(read_all(conn, input))
+    {
+      std::istringstream is(input);
+      std::string error;
+      try
+      {
+        sess.run(is, output);
+      }
+      catch(const std::exception& e)
+      {
+        // limits and `run_error`s end only this run, the session serves the next one
+        error = std::string("error: ") + e.what() + "\n";
+      }
+      auto out = output.str();
+      write_all(conn, (error.empty() ? "0 " : "1 ") + std::to_string(out.size()) + "\n" + out + error);
+    }
+    close(conn);
+  }
+  close(fd);
+  return 1;
+}
+
+int request(const std::string& path, std::istream& is, std::ostream& os, std::ostream& err)
+{
+  sockaddr_un addr;
+  if(!make_address(path, addr, err))
+    return 1;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+  {
+    err << "error: cannot connect to " << path << ": " << std::strerror(errno) << "\n";
+    if(fd >= 0)
+      close(fd);
+    return 1;
+  }
+
+  std::stringstream ss;
+  ss << is.rdbuf();
+  std::string answer;
+  bool ok = write_all(fd, ss.str()) && shutdown(fd, SHUT_WR) == 0 && read_all(fd, answer);
+  close(fd);
+  // STATUS OUTPUT-LENGTH \n OUTPUT ERROR
+  std::istringstream head(answer);
+  char status = 0;
+  std::size_t length = 0;
+  if(ok && head >> status >> length && head.get() == '\n')
+  {
+    const auto begin = static_cast<std::size_t>(head.tellg());
+    ok = (status == '0' || status == '1') && length <= answer.size() - begin;
+    if(ok)
+    {
+      os.write(answer.data() + begin, static_cast<std::streamsize>(length));
+      err << std::string_view(answer).substr(begin + length);
+      return status == '0' ? 0 : 1;
+    }
+  }
+  err << "error: lost connection to " << path << "\n";
+  return 1;
+}
@@ -1,5 +1,10 @@
 #include "source_range.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include <mutex>
+
 source_range::source_range(std::string_view module, std::size_t column_beg, std::size_t row_beg,
                                                     std::size_t column_end, std::size_t row_end)
   : module(module), column_beg(column_beg), row_beg(row_beg), column_end(column_end), row_end(row_end)
@@ -22,8 +27,8 @@ source_range& source_range::operator+=(const source_range& other)
 std::string source_range::to_string() const
 {
   return std::string(module) + ":"
-    + std::to_string(column_beg) + ":"
-    + std::to_string(row_beg);
+    + std::to_string(row_beg) + ":"
+    + std::to_string(column_beg);
 }
 
 std::ostream& operator<<(std::ostream& os, const source_range& src_range)
@@ -40,3 +45,59 @@ source_range operator+(const source_range& left, const source_range& right)
   return range;
 }
 
+
+namespace source_map
+{
+  static std::mutex mut;
+
+  // file 0 is where default constructed locations point to, it is never dropped
+  static const auto unknown = std::make_shared<source_file>(source_file { "<unknown>", { 0 } });
+  static std::vector<std::weak_ptr<source_file>> files { unknown };
+
+  std::shared_ptr<source_file> add(std::string_view name, std::uint32_t& id)
+  {
+    auto file = std::make_shared<source_file>(source_file { std::string(name), {} });
+
+    // the id of a dropped module is free again
+    std::lock_guard<std::mutex> lock(mut);
+    auto free = std::find_if(files.begin(), files.end(), [](auto& f) { return f.expired(); });
+    id = static_cast<std::uint32_t>(free - files.begin());
+    if(free == files.end())
+      files.emplace_back(file);
+    else
+      *free = file;
+    return file;
+  }
+
+  std::shared_ptr<const source_file> get(std::uint32_t id)
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    assert(id < files.size() && "Unknown source file.");
+    auto file = files[id].lock();
+    return file ? file : unknown;
+  }
+}
+
+source_range source_loc::resolve() const
+{
+  auto keep = source_map::get(file);
+  auto& f = *keep;
+
+  // rows and columns start at 1
+  auto line = std::upper_bound(f.line_starts.begin(), f.line_starts.end(), offset);
+  std::size_t row = line - f.line_starts.begin();
+  std::size_t column = offset - (row > 0 ? f.line_starts[row - 1] : 0) + 1;
+  return source_range(f.name, column, std::max<std::size_t>(row, 1), column, std::max<std::size_t>(row, 1));
+}
+
+std::string source_loc::to_string() const
+{
+  // the range only views the name of the module
+  auto keep = source_map::get(file);
+  return resolve().to_string();
+}
+
+std::ostream& operator<<(std::ostream& os, const source_loc& loc)
+{
+  return os << loc.to_string();
+}
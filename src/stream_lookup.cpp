@@ -1,6 +1,7 @@
 #include <stream_lookup.hpp>
 
 #include <filesystem>
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <iomanip>
@@ -18,7 +19,7 @@ constexpr static auto cur_time = [](){
     };
 
 stream_lookup_t::stream_lookup_t()
-  : files(), map(),
+  : map(),
   stdin_module((fs::temp_directory_path() / ("STDIN_" + cur_time())).string())
 {
 }
@@ -32,35 +33,40 @@ void stream_lookup_t::process_stdin()
 {
 }
 
-std::istream& stream_lookup_t::operator[](std::string_view str)
+std::string stream_lookup_t::resolve(std::string_view str)
 {
   if(str == "STDIN")
   {
     if(!stdin_processed)
       process_stdin();
-    str = stdin_module;
+    return stdin_module;
   }
-  auto it = map.find(str);
-  assert(it == map.end() && "Stream should have been dropped.");
+  return std::string(str);
+}
 
-  files.push_back(std::move(std::make_unique<std::ifstream>(str.data())));
+std::istream& stream_lookup_t::operator[](std::string_view str)
+{
+  std::lock_guard<std::mutex> lock(mut);
 
-  map[str] = files.end() - 1;
+  auto name = resolve(str);
+  auto& streams = map[name];
+  streams.emplace_back(std::make_unique<std::ifstream>(name));
 
-  return *files.back();
+  return *streams.back();
 }
 
-void stream_lookup_t::drop(std::string_view str)
+void stream_lookup_t::drop(std::string_view str, std::istream& is)
 {
-  if(str == "STDIN")
-  {
-    str = stdin_module;
-  }
-  auto it = map.find(str);
+  std::lock_guard<std::mutex> lock(mut);
 
+  auto it = map.find(resolve(str));
   assert(it != map.end() && "Stream should exist.");
 
-  files.erase(it->second);
-  map.erase(it);
-}
+  auto& streams = it->second;
+  auto pos = std::find_if(streams.begin(), streams.end(), [&is](auto& s) { return s.get() == &is; });
+  assert(pos != streams.end() && "Stream should exist.");
 
+  streams.erase(pos);
+  if(streams.empty())
+    map.erase(it);
+}
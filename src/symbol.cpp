@@ -1,5 +1,8 @@
 #include <symbol.hpp>
 
+#include <shared_mutex>
+#include <cassert>
+#include <deque>
 #include <mutex>
 
 struct nonesuch {
@@ -35,7 +38,8 @@ template<typename T>
 constexpr bool has_method_empty()
 { return is_detected<has_method_empty_trait, T>::value; }
 
-template<typename T, typename H = std::uint_fast32_t>
+// FNV-1a, the key a symbol is interned under unless another string has it already
+template<typename T, typename H = std::uint_fast64_t>
 constexpr H hash_string(T str)
 {
   if constexpr(has_method_empty<T>())
@@ -48,23 +52,24 @@ constexpr H hash_string(T str)
     // probably a c style string thing    (could also use a trait and throw error if this interface is also not provided)
     if(!str) return 0;
   }
-  H hash = str[0];
+  H hash = 14695981039346656037ull;
   for(auto* p = &str[0]; p && *p != '\0'; p++)
-    hash ^= (hash * 31) + (*p);
+    hash = (hash ^ static_cast<unsigned char>(*p)) * 1099511628211ull;
   return hash;
 }
 
-static std::mutex symbol_table_mutex;
+static std::shared_mutex symbol_table_mutex;
+static std::deque<std::string> symbol_strings;
 
-tsl::robin_map<std::uint_fast64_t, std::string> symbol::symbols = {};
+tsl::robin_map<std::uint_fast64_t, const std::string*> symbol::symbols = {};
 
 symbol::symbol(const std::string& str)
-  : hash_(hash_string(str))
-{ lookup_or_emplace(hash(), str.c_str()); }
+  : hash_(lookup_or_emplace(hash_string(str), str.c_str()))
+{  }
 
 symbol::symbol(const char* str)
-  : hash_(hash_string(str))
-{ lookup_or_emplace(hash(), str); }
+  : hash_(lookup_or_emplace(hash_string(str), str))
+{  }
 
 symbol::symbol(const symbol& s)
   : hash_(s.hash())
@@ -79,16 +84,14 @@ symbol::~symbol() noexcept
 
 symbol& symbol::operator=(const std::string& str)
 {
-  hash_ = hash_string(str);
-  lookup_or_emplace(hash(), str.c_str());
+  hash_ = lookup_or_emplace(hash_string(str), str.c_str());
 
   return *this;
 }
 
 symbol& symbol::operator=(const char* str)
 {
-  hash_ = hash_string(str);
-  lookup_or_emplace(hash(), str);
+  hash_ = lookup_or_emplace(hash_string(str), str);
 
   return *this;
 }
@@ -109,19 +112,39 @@ symbol& symbol::operator=(symbol&& s)
 
 std::ostream& operator<<(std::ostream& os, const symbol& symb)
 {
-  os << symbol::symbols[symb.hash()];
+  os << symb.str();
   return os;
 }
 
-std::string& symbol::lookup_or_emplace(std::uint_fast64_t hash, const char* str)
+// The strings are compared whenever the keys match. A string whose hash is taken by
+//  another one goes to the next free key, so every string has a key of its own.
+std::uint_fast64_t symbol::lookup_or_emplace(std::uint_fast64_t hash, const char* str)
 {
-  auto it = symbols.find(hash);
-  if(it != symbols.end())
-    return symbols[hash];
+  auto key = hash;
+  {
+    std::shared_lock<std::shared_mutex> lock(symbol_table_mutex);
+    for(auto it = symbols.find(key); it != symbols.end(); it = symbols.find(++key))
+      if(*it->second == str)
+        return key;
+  }
+  std::unique_lock<std::shared_mutex> lock(symbol_table_mutex);
+  // someone else might have been faster
+  key = hash;
+  for(auto it = symbols.find(key); it != symbols.end(); it = symbols.find(++key))
+    if(*it->second == str)
+      return key;
+
+  symbol_strings.emplace_back(str);
+  symbols.emplace(key, &symbol_strings.back());
+  return key;
+}
 
-  std::lock_guard<std::mutex> lock(symbol_table_mutex);
-  symbols[hash] = str;
-  return symbols[hash];
+const std::string& symbol::lookup(std::uint_fast64_t hash)
+{
+  std::shared_lock<std::shared_mutex> lock(symbol_table_mutex);
+  auto it = symbols.find(hash);
+  assert(it != symbols.end() && "Symbol was never interned.");
+  return *it->second;
 }
 
 std::ostream& operator<<(std::ostream& os, const std::vector<symbol>& symbs)
@@ -135,8 +158,9 @@ std::uint_fast64_t symbol::hash() const
 { return hash_; }
 
 const std::string& symbol::str() const
-{ return symbols[hash()]; }
+{ return lookup(hash()); }
 
+// keys are unique per string, see `lookup_or_emplace`
 bool operator==(const symbol& a, const symbol& b)
 { return a.hash() == b.hash(); }
 
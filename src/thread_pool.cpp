@@ -0,0 +1,160 @@
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <cassert>
+
+// queue of the current thread, threads not owned by a pool share the last queue
+static thread_local std::size_t current_queue = static_cast<std::size_t>(-1);
+
+static std::size_t global_threads = 0;
+static std::atomic<std::size_t> spawned { 0 };
+
+thread_pool::thread_pool(std::size_t threads)
+  : queues()
+  , workers()
+{
+  threads = std::max<std::size_t>(threads, 1);
+  for(std::size_t i = 0; i < threads; ++i)
+    queues.emplace_back(std::make_unique<queue>());
+
+  // the thread calling `parallel_for` works as well, so spawn one less
+  for(std::size_t i = 0; i + 1 < threads; ++i)
+    workers.emplace_back([this, i]() { work(i); });
+  spawned += workers.size();
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_mut);
+    stop = true;
+  }
+  wakeup.notify_all();
+
+  for(auto& w : workers)
+    w.join();
+  spawned -= workers.size();
+}
+
+thread_pool& thread_pool::global()
+{
+  static thread_pool pool(global_threads != 0 ? global_threads
+                                              : std::max(1u, std::thread::hardware_concurrency()));
+  return pool;
+}
+
+void thread_pool::set_threads(std::size_t threads)
+{ global_threads = threads; }
+
+bool thread_pool::spawned_threads()
+{ return spawned > 0; }
+
+void thread_pool::push(std::size_t q, Task&& task)
+{
+  {
+    std::lock_guard<std::mutex> lock(queues[q]->mut);
+    queues[q]->tasks.emplace_back(std::move(task));
+  }
+  pending++;
+
+  // take the lock so that no worker misses the update between checking and sleeping
+  { std::lock_guard<std::mutex> lock(sleep_mut); }
+  wakeup.notify_all();
+}
+
+bool thread_pool::try_run(std::size_t self)
+{
+  Task task;
+  for(std::size_t i = 0; i < queues.size() && !task; ++i)
+  {
+    auto& q = *queues[(self + i) % queues.size()];
+
+    std::lock_guard<std::mutex> lock(q.mut);
+    if(q.tasks.empty())
+      continue;
+
+    // own work is LIFO for locality, stolen work FIFO to take the biggest chunks
+    if(i == 0)
+    {
+      task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+    }
+    else
+    {
+      task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+    }
+  }
+  if(!task)
+    return false;
+
+  pending--;
+  task();
+  return true;
+}
+
+void thread_pool::work(std::size_t self)
+{
+  current_queue = self;
+  while(!stop)
+  {
+    if(try_run(self))
+      continue;
+
+    std::unique_lock<std::mutex> lock(sleep_mut);
+    wakeup.wait(lock, [this]() { return stop || pending > 0; });
+  }
+}
+
+void thread_pool::parallel_for(std::size_t beg, std::size_t end, std::size_t grain,
+                               const std::function<void(std::size_t, std::size_t)>& f)
+{
+  if(beg >= end)
+    return;
+  grain = std::max<std::size_t>(grain, 1);
+
+  const std::size_t self = (current_queue < queues.size() ? current_queue : queues.size() - 1);
+
+  std::atomic<std::size_t> remaining { (end - beg + grain - 1) / grain };
+  std::exception_ptr error;
+  std::mutex error_mut;
+
+  for(std::size_t b = beg; b < end; b += grain)
+  {
+    const std::size_t e = std::min(end, b + grain);
+    push(self, [&, b, e]()
+    {
+      try
+      {
+        f(b, e);
+      }
+      catch(...)
+      {
+        std::lock_guard<std::mutex> lock(error_mut);
+        if(!error)
+          error = std::current_exception();
+      }
+      // the waiting thread may be asleep, see below
+      if(--remaining == 0)
+      {
+        { std::lock_guard<std::mutex> lock(sleep_mut); }
+        wakeup.notify_all();
+      }
+    });
+  }
+
+  // Help out instead of blocking, this is what makes nested parallel loops work. Once
+  //  nothing is left to steal, sleep until the last chunk is done or new work comes in.
+  while(remaining > 0)
+  {
+    if(try_run(self))
+      continue;
+
+    std::unique_lock<std::mutex> lock(sleep_mut);
+    wakeup.wait(lock, [this, &remaining]() { return remaining == 0 || pending > 0; });
+  }
+
+  if(error)
+    std::rethrow_exception(error);
+}
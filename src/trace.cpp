@@ -0,0 +1,213 @@
+#include <trace.hpp>
+#include <ast.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace trace
+{
+static constexpr char magic[8] = { 'R', 'A', 'L', 'T', 'R', 'A', 'C', 'E' };
+static constexpr std::uint32_t version = 1;
+
+static std::atomic<bool> on { false };
+static std::size_t ring_capacity { 0 };
+
+static std::mutex rings_mutex;
+static std::deque<std::unique_ptr<ring>> rings;
+
+static volatile std::sig_atomic_t requested = 0;
+static std::atomic<bool> watching { false };
+static std::string signal_path;
+
+ring::ring(std::size_t capacity, std::uint32_t thread)
+  : events(new stored_event[capacity])
+  , mask(capacity - 1)
+  , thread(thread)
+{  }
+
+void enable(std::size_t capacity)
+{
+  std::size_t cap = 1;
+  while(cap < capacity)
+    cap *= 2;
+  ring_capacity = cap;
+  on = true;
+}
+
+bool enabled()
+{
+  return on.load(std::memory_order_relaxed);
+}
+
+ring& local()
+{
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  rings.emplace_back(std::make_unique<ring>(ring_capacity, static_cast<std::uint32_t>(rings.size())));
+  return *rings.back();
+}
+
+template<typename T>
+static void put(std::ostream& os, const T& v)
+{ os.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+template<typename T>
+static bool get(std::istream& is, T& v)
+{ return bool(is.read(reinterpret_cast<char*>(&v), sizeof(T))); }
+
+bool dump(const std::string& path, std::ostream& err)
+{
+  std::ofstream os(path, std::ios::binary);
+  if(!os)
+  {
+    err << "error: cannot write trace " << path << "\n";
+    return false;
+  }
+  os.write(magic, sizeof(magic));
+  put(os, version);
+
+  const auto count = slot_count();
+  put(os, count);
+  for(std::uint32_t i = 0; i < count; ++i)
+  {
+    auto name = slot_name(i);
+    put(os, static_cast<std::uint32_t>(name.size()));
+    os.write(name.data(), name.size());
+  }
+
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  put(os, static_cast<std::uint32_t>(rings.size()));
+  std::vector<event> copy;
+  for(auto& r : rings)
+  {
+    // the owner keeps writing, events it overwrote while we copied are dropped
+    const std::uint64_t size = r->mask + 1;
+    const auto end = r->head.load(std::memory_order_acquire);
+    const auto beg = end > size ? end - size : 0;
+    copy.clear();
+    for(auto i = beg; i < end; ++i)
+      copy.emplace_back(r->events[i & r->mask].load());
+    // the event at `now` may be half written over the oldest one of the window
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const auto now = r->head.load(std::memory_order_relaxed);
+    const auto valid = now + 1 > size ? now + 1 - size : 0;
+    const auto skip = valid > beg ? std::min<std::uint64_t>(valid - beg, copy.size()) : 0;
+
+    put(os, r->thread);
+    put(os, end);
+    put(os, static_cast<std::uint64_t>(copy.size() - skip));
+    os.write(reinterpret_cast<const char*>(copy.data() + skip), (copy.size() - skip) * sizeof(event));
+  }
+  return bool(os);
+}
+
+static void on_signal(int)
+{
+  requested = 1;
+}
+
+void dump_on_signal(int signal, const std::string& path)
+{
+  signal_path = path;
+  watching = true;
+  std::signal(signal, on_signal);
+}
+
+void poll()
+{
+  if(!watching.load(std::memory_order_relaxed) || !requested)
+    return;
+  requested = 0;
+
+  static std::mutex dumping;
+  std::lock_guard<std::mutex> lock(dumping);
+  dump(signal_path, std::cerr);
+}
+
+static const char* kind_name(event_kind k)
+{
+  switch(k)
+  {
+  case event_kind::call:        return "call";
+  case event_kind::call_exit:   return "return";
+  case event_kind::uncall:      return "uncall";
+  case event_kind::uncall_exit: return "unreturn";
+  case event_kind::iteration:   return "iterate";
+  case event_kind::do_begin:    return "do";
+  case event_kind::yield:       return "yield";
+  case event_kind::undo:        return "undo";
+  case event_kind::let:         return "let";
+  case event_kind::unlet:       return "unlet";
+  }
+  return "?";
+}
+
+bool decode(std::istream& is, std::ostream& os, std::ostream& err)
+{
+  char m[sizeof(magic)];
+  std::uint32_t ver = 0;
+  if(!is.read(m, sizeof(m)) || !std::equal(m, m + sizeof(m), magic) || !get(is, ver))
+  {
+    err << "error: not a ral trace\n";
+    return false;
+  }
+  if(ver != version)
+  {
+    err << "error: trace has version " << ver << ", expected " << version << "\n";
+    return false;
+  }
+
+  std::uint32_t count = 0;
+  get(is, count);
+  std::vector<std::string> names(count);
+  for(auto& name : names)
+  {
+    std::uint32_t len = 0;
+    get(is, len);
+    name.resize(len);
+    is.read(name.data(), len);
+  }
+
+  std::uint32_t nrings = 0;
+  get(is, nrings);
+  for(std::uint32_t r = 0; r < nrings && is; ++r)
+  {
+    std::uint32_t thread = 0;
+    std::uint64_t total = 0, n = 0;
+    get(is, thread);
+    get(is, total);
+    get(is, n);
+    os << "thread " << thread << ": " << total << " events, last " << n << "\n";
+
+    for(std::uint64_t i = 0; i < n; ++i)
+    {
+      event e;
+      if(!get(is, e))
+      {
+        err << "error: trace is truncated\n";
+        return false;
+      }
+      os << std::setw(12) << e.step << "  " << std::left << std::setw(9) << kind_name(e.kind) << std::right;
+      switch(e.kind)
+      {
+      case event_kind::iteration:
+      case event_kind::do_begin:
+      case event_kind::yield:
+      case event_kind::undo:
+        os << e.value;
+        break;
+      default:
+        os << (e.id < names.size() ? names[e.id] : "?") << " " << e.value;
+        break;
+      }
+      os << "\n";
+    }
+  }
+  return true;
+}
+}
@@ -1,9 +1,30 @@
 #include <type.hpp>
 #include <ast.hpp>
 #include <cassert>
+#include <map>
+
+bool is_int(TypeKind kind)
+{
+  switch(kind)
+  {
+  case TypeKind::I8:
+  case TypeKind::I16:
+  case TypeKind::I32:
+  case TypeKind::I64:
+  case TypeKind::U64:
+    return true;
+  }
+  return false;
+}
 
 bool is_int(Type& typ)
-{ return typ.kind == TypeKind::Int; }
+{ return is_int(typ.kind); }
+
+bool is_array(const Type::Ptr& typ)
+{ return typ && typ->kind == TypeKind::Array; }
+
+bool is_container(const Type::Ptr& typ)
+{ return typ && (typ->kind == TypeKind::Stack || typ->kind == TypeKind::Queue); }
 
 Type::Ptr mk_pointer(Type::Ptr typ)
 {
@@ -17,8 +38,16 @@ Type::Ptr str2typ(const std::string& str)
   // TODO: Add more
   if(str == "()")
     return unit_type();
-  else if(str == "i32" || str == "int")
-    return int_type();
+  else if(str == "i8")
+    return int_type(TypeKind::I8);
+  else if(str == "i16")
+    return int_type(TypeKind::I16);
+  else if(str == "i32")
+    return int_type(TypeKind::I32);
+  else if(str == "i64")
+    return int_type(TypeKind::I64);
+  else if(str == "u64" || str == "int")
+    return int_type(TypeKind::U64);
   return nullptr;
 }
 
@@ -27,9 +56,27 @@ Type::Ptr unit_type()
   return std::make_shared<Type>(TypeKind::Unit, std::vector<Type::Ptr>{});
 }
 
-Type::Ptr int_type()
+Type::Ptr int_type(TypeKind kind)
 {
-  return std::make_shared<Type>(TypeKind::Int, std::vector<Type::Ptr>{});
+  assert(is_int(kind));
+  return std::make_shared<Type>(kind, std::vector<Type::Ptr>{});
+}
+
+Type::Ptr array_type(Type::Ptr&& elem, std::size_t length)
+{
+  assert(elem && is_int(*elem) && "Only arrays of integers are supported.");
+  std::vector<Type::Ptr> v;
+  v.emplace_back(std::move(elem));
+  return std::make_shared<Type>(TypeKind::Array, std::move(v), length);
+}
+
+Type::Ptr container_type(TypeKind kind, Type::Ptr&& elem)
+{
+  assert((kind == TypeKind::Stack || kind == TypeKind::Queue) && "Not a container.");
+  assert(elem && is_int(*elem) && "Only containers of integers are supported.");
+  std::vector<Type::Ptr> v;
+  v.emplace_back(std::move(elem));
+  return std::make_shared<Type>(kind, std::move(v));
 }
 
 Type::Ptr fn_type(std::vector<Type::Ptr>&& params, Type::Ptr&& ret)
@@ -54,33 +101,152 @@ std::vector<Type::Ptr> Type::Fn::params(Type::Ptr fn)
   return params;
 }
 
-void infer(Node* n)
+Type::Ptr Type::Array::elem(Type::Ptr arr)
 {
-  if(!n || n->typ)
-    return;
+  assert(arr && arr->kind == TypeKind::Array);
+  return arr->args.front();
+}
+
+std::size_t Type::Array::length(Type::Ptr arr)
+{
+  assert(arr && arr->kind == TypeKind::Array);
+  return arr->length;
+}
+
+Type::Ptr Type::Container::elem(Type::Ptr c)
+{
+  assert(is_container(c));
+  return c->args.front();
+}
 
-  // infer children
-  for(auto& x : n->lhs)
-    infer(x.get());
+struct inferer
+{
+  void operator()(Node* n)
+  {
+    if(!n || n->typ)
+      return;
+
+    switch(n->kind)
+    {
+    default:
+      for(auto& x : n->lhs)
+        (*this)(x.get());
+      return;
+
+    case NodeKind::Num:
+      n->typ = int_type();
+      return;
+
+    case NodeKind::Var:
+    {
+      auto it = env.find(std::get<Object>(n->data).name);
+      n->typ = (it != env.end() ? it->second : int_type());
+      return;
+    }
+
+    case NodeKind::Index:
+      (*this)(n->lhs[0].get());
+      (*this)(n->lhs[1].get());
+      assert(is_array(n->lhs[0]->typ) && "Only arrays can be indexed.");
+
+      n->typ = Type::Array::elem(n->lhs[0]->typ);
+      return;
+
+    case NodeKind::Let:
+    case NodeKind::Unlet:
+    {
+      auto& id = n->lhs[0];
+      auto& exp = n->lhs[1];
+      (*this)(exp.get());
+
+      // `let x : T := e` already carries its type, otherwise it is taken from `e`
+      if(!id->typ)
+      {
+        auto it = env.find(std::get<Object>(id->data).name);
+        if(n->kind == NodeKind::Unlet && it != env.end())
+          id->typ = it->second;
+        else
+          id->typ = (exp->kind != NodeKind::Num && exp->typ ? exp->typ : int_type());
+      }
+      env[std::get<Object>(id->data).name] = id->typ;
+      unify_literal(exp.get(), id->typ);
+
+      n->typ = id->typ;
+      return;
+    }
+
+    case NodeKind::Push:
+    case NodeKind::Pop:
+      (*this)(n->lhs[0].get());
+      (*this)(n->lhs[1].get());
+      assert(is_container(n->lhs[1]->typ) && "Only stacks and queues can be pushed to and popped from.");
+      assert(n->lhs[0]->typ && n->lhs[0]->typ->kind == Type::Container::elem(n->lhs[1]->typ)->kind
+             && "Pushed and popped values must have the element type.");
+      return;
+
+    case NodeKind::Size:
+    case NodeKind::Top:
+      (*this)(n->lhs[0].get());
+      assert(is_container(n->lhs[0]->typ) && "Only stacks and queues have a size and a top.");
+
+      n->typ = (n->kind == NodeKind::Size ? int_type() : Type::Container::elem(n->lhs[0]->typ));
+      return;
+
+    case NodeKind::OpEq:
+      (*this)(n->lhs[0].get());
+      (*this)(n->lhs[1].get());
+      unify_literal(n->lhs[1].get(), n->lhs[0]->typ);
+
+      n->typ = n->lhs[0]->typ;
+      return;
+
+    case NodeKind::Cmp:
+      (*this)(n->lhs[0].get());
+      (*this)(n->lhs[1].get());
+      unify_literal(n->lhs[0].get(), n->lhs[1]->typ);
+      unify_literal(n->lhs[1].get(), n->lhs[0]->typ);
+
+      n->typ = int_type();
+      return;
+
+    case NodeKind::Arith:
+      (*this)(n->lhs[0].get());
+      (*this)(n->lhs[1].get());
+      unify_literal(n->lhs[0].get(), n->lhs[1]->typ);
+      unify_literal(n->lhs[1].get(), n->lhs[0]->typ);
+      assert(is_int(*n->lhs[0]->typ) && is_int(*n->lhs[1]->typ)
+             && "Only integers can be added, subtracted, multiplied and divided.");
+
+      n->typ = n->lhs[0]->typ;
+      return;
+
+    case NodeKind::Call:
+    case NodeKind::Uncall:
+      // the callee is not a variable, only type the store and the arguments
+      n->lhs[0]->typ = (std::get<Object>(n->lhs[1]->data).name == "read" ? int_type() : unit_type());
+      env[std::get<Object>(n->lhs[0]->data).name] = n->lhs[0]->typ;
+      for(std::size_t i = 2; i < n->lhs.size(); ++i)
+        (*this)(n->lhs[i].get());
+      return;
+    }
+  }
 
-  switch(n->kind)
+  // literals adapt to the width of the other operand, or its elements
+  void unify_literal(Node* n, const Type::Ptr& typ)
   {
-  case NodeKind::Let:
-    n->typ = n->lhs.front()->typ;
-    return;
-
-  case NodeKind::Cmp:
-  case NodeKind::Num:
-  case NodeKind::Var:
-    n->typ = int_type();
-    return;
+    if(is_array(typ))
+      unify_literal(n, Type::Array::elem(typ));
+    else if(n->kind == NodeKind::Num && typ && is_int(*typ))
+      n->typ = typ;
   }
-}
+
+  std::map<std::string, Type::Ptr> env;
+};
 
 void infer(Fn* f)
 {
-  // TODO: move this into a class and collect param typs in an environment
-  infer(f->body.get());
+  inferer inf;
+  for(auto& p : f->params)
+    inf.env[p.name] = p.type;
+  inf(f->body.get());
 }
-
-
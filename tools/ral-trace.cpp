@@ -0,0 +1,21 @@
+#include <trace.hpp>
+
+#include <iostream>
+#include <fstream>
+
+// Prints a trace written by `ral --trace FILE`.
+int main(int argc, char** argv)
+{
+  if(argc != 2)
+  {
+    std::cerr << "usage: " << argv[0] << " TRACE\n";
+    return 1;
+  }
+  std::ifstream is(argv[1], std::ios::binary);
+  if(!is)
+  {
+    std::cerr << "error: cannot read " << argv[1] << "\n";
+    return 1;
+  }
+  return trace::decode(is, std::cout, std::cerr) ? 0 : 1;
+}